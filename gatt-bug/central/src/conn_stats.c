@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#if defined(CONFIG_ARCH_POSIX)
+#include "posix_native_task.h"
+#endif
+
+#include "conn_stats.h"
+
+struct latency {
+	uint32_t count;
+	int64_t sum;
+	int64_t min;
+	int64_t max;
+};
+
+static const char *const names[CONN_STAT_COUNT] = {
+	[CONN_STAT_SETUP] = "setup",
+	[CONN_STAT_SUBSCRIBE] = "subscribe",
+	[CONN_STAT_FIRST_NTF] = "first_ntf",
+	[CONN_STAT_SUBSCRIBE_CACHED] = "subscribe_cached",
+	[CONN_STAT_FIRST_NTF_CACHED] = "first_ntf_cached",
+	[CONN_STAT_PHY_UPDATE] = "phy_update",
+	[CONN_STAT_DATA_LEN_UPDATE] = "data_len_update",
+	[CONN_STAT_MTU_EXCHANGE] = "mtu_exchange",
+	[CONN_STAT_CONN_PARAM_UPDATE] = "conn_param_update",
+	[CONN_STAT_LINK_TUNING] = "link_tuning",
+	[CONN_STAT_SECURITY] = "security",
+	[CONN_STAT_PAIRING] = "pairing",
+	[CONN_STAT_RESUME] = "resume",
+	[CONN_STAT_EATT] = "eatt",
+	[CONN_STAT_RECONNECT] = "reconnect",
+};
+
+static struct latency stats[CONN_STAT_COUNT];
+static struct k_spinlock lock;
+
+extern uint64_t total_rx_count;
+extern uint64_t run_rx_count;
+
+void conn_stats_record(enum conn_stat stat, int64_t us)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct latency *l = &stats[stat];
+
+	if (!l->count) {
+		l->min = us;
+		l->max = us;
+	}
+
+	l->count++;
+	l->sum += us;
+	l->min = MIN(l->min, us);
+	l->max = MAX(l->max, us);
+
+	k_spin_unlock(&lock, key);
+}
+
+void conn_stats_print(void)
+{
+	struct latency l;
+
+	printk("[CONN STATS] latency (us): count min/avg/max\n");
+
+	for (size_t i = 0; i < CONN_STAT_COUNT; i++) {
+		l = stats[i];
+		printk("[CONN STATS] %-18s %u %lld/%lld/%lld\n", names[i], l.count,
+		       l.min, l.count ? l.sum / l.count : 0, l.max);
+	}
+
+	printk("METRICS {\"total_rx_count\": %llu, \"run_rx_count\": %llu", total_rx_count,
+	       run_rx_count);
+	for (size_t i = 0; i < CONN_STAT_COUNT; i++) {
+		l = stats[i];
+		printk(", \"%s_us\": {\"count\": %u, \"min\": %lld, \"avg\": %lld, \"max\": %lld}",
+		       names[i], l.count, l.min, l.count ? l.sum / l.count : 0, l.max);
+	}
+	printk("}\n");
+}
+
+#if defined(CONFIG_ARCH_POSIX)
+NATIVE_TASK(conn_stats_print, ON_EXIT, 10);
+#endif
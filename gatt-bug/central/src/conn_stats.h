@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef CONN_STATS_H_
+#define CONN_STATS_H_
+
+#include <stdint.h>
+
+enum conn_stat {
+	/* Advertising report that triggered the connection -> connected */
+	CONN_STAT_SETUP,
+	/* Connected -> subscribed to the HRS measurement */
+	CONN_STAT_SUBSCRIBE,
+	/* Connected -> first notification received */
+	CONN_STAT_FIRST_NTF,
+	/* Same two, when the GATT cache allowed skipping discovery */
+	CONN_STAT_SUBSCRIBE_CACHED,
+	CONN_STAT_FIRST_NTF_CACHED,
+	/* Link tuning: duration of each step, and connected -> tuned */
+	CONN_STAT_PHY_UPDATE,
+	CONN_STAT_DATA_LEN_UPDATE,
+	CONN_STAT_MTU_EXCHANGE,
+	CONN_STAT_CONN_PARAM_UPDATE,
+	CONN_STAT_LINK_TUNING,
+	/* Security: connected -> encrypted with new keys, connected -> pairing
+	 * complete (keys distributed), connected -> encrypted with the stored
+	 * LTK of a bonded peer
+	 */
+	CONN_STAT_SECURITY,
+	CONN_STAT_PAIRING,
+	CONN_STAT_RESUME,
+	/* EATT: connected -> enhanced bearers up */
+	CONN_STAT_EATT,
+	/* Disconnected -> connected again to the same peer */
+	CONN_STAT_RECONNECT,
+
+	CONN_STAT_COUNT,
+};
+
+/* Account one latency sample, in microseconds */
+void conn_stats_record(enum conn_stat stat, int64_t us);
+
+/* Print min/avg/max of every latency, and a METRICS line */
+void conn_stats_print(void);
+
+#endif /* CONN_STATS_H_ */
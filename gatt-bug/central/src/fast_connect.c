@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+
+#include "fast_connect.h"
+#include "gatt_cache.h"
+
+/* The controller can't tell us what is in its Filter Accept List, so we
+ * keep our own copy.
+ */
+static bt_addr_le_t known[CONFIG_CENTRAL_FAST_CONNECT_MAX];
+static size_t known_count;
+
+static bool auto_connecting;
+static bool backoff;
+static void (*retry_cb)(void);
+
+static void backoff_work_handler(struct k_work *work)
+{
+	backoff = false;
+
+	if (retry_cb) {
+		retry_cb();
+	}
+}
+
+static K_WORK_DELAYABLE_DEFINE(backoff_work, backoff_work_handler);
+
+void fast_connect_learn(const bt_addr_le_t *addr)
+{
+	int err;
+
+	if (fast_connect_is_known(addr)) {
+		return;
+	}
+
+	if (known_count >= ARRAY_SIZE(known)) {
+		return;
+	}
+
+	err = bt_le_filter_accept_list_add(addr);
+	if (err) {
+		printk("Failed to add peer to the Filter Accept List (err %d)\n", err);
+		return;
+	}
+
+	bt_addr_le_copy(&known[known_count++], addr);
+}
+
+static void cached_peer(const bt_addr_le_t *addr, void *user_data)
+{
+	fast_connect_learn(addr);
+}
+
+static void bonded_peer(const struct bt_bond_info *info, void *user_data)
+{
+	fast_connect_learn(&info->addr);
+}
+
+bool fast_connect_is_known(const bt_addr_le_t *addr)
+{
+	for (size_t i = 0; i < known_count; i++) {
+		if (bt_addr_le_eq(&known[i], addr)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void fast_connect_init(void (*retry)(void))
+{
+	retry_cb = retry;
+
+	if (IS_ENABLED(CONFIG_CENTRAL_GATT_CACHE)) {
+		gatt_cache_foreach(cached_peer, NULL);
+	}
+
+	bt_foreach_bond(BT_ID_DEFAULT, bonded_peer, NULL);
+
+	printk("%u known peers in the Filter Accept List\n", known_count);
+}
+
+bool fast_connect_start(size_t known_connected)
+{
+	int err;
+
+	if (backoff || auto_connecting || known_count <= known_connected) {
+		return false;
+	}
+
+	/* Initiating and scanning can't run at the same time */
+	err = bt_le_scan_stop();
+	if (err && err != -EALREADY) {
+		printk("Stop LE scan failed (err %d)\n", err);
+		return false;
+	}
+
+	err = bt_conn_le_create_auto(BT_CONN_LE_CREATE_CONN_AUTO, BT_LE_CONN_PARAM_DEFAULT);
+	if (err) {
+		printk("Auto-connect failed to start (err %d)\n", err);
+		return false;
+	}
+
+	auto_connecting = true;
+	printk("Auto-connecting to %u known peers\n", known_count - known_connected);
+
+	return true;
+}
+
+void fast_connect_done(bool timeout)
+{
+	if (!auto_connecting) {
+		return;
+	}
+
+	auto_connecting = false;
+
+	if (timeout) {
+		/* Some known peers are gone, look for new ones for a while */
+		backoff = true;
+		k_work_schedule(&backoff_work, K_SECONDS(CONFIG_CENTRAL_FAST_CONNECT_SCAN_S));
+	}
+}
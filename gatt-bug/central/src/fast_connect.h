@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FAST_CONNECT_H_
+#define FAST_CONNECT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <zephyr/bluetooth/addr.h>
+
+/* Put the peers we know (GATT cache and bonds) in the controller's Filter
+ * Accept List. `retry` is called when it is time to try auto-connecting
+ * again after a timeout. Call after bt_enable() and gatt_cache_init().
+ */
+void fast_connect_init(void (*retry)(void));
+
+/* Add a peer to the Filter Accept List. Must not be called while
+ * auto-connecting.
+ */
+void fast_connect_learn(const bt_addr_le_t *addr);
+
+/* Whether the peer is in the Filter Accept List */
+bool fast_connect_is_known(const bt_addr_le_t *addr);
+
+/* Start auto-connecting if some known peers are not connected,
+ * `known_connected` being how many of them are. Returns true if the
+ * controller is now initiating.
+ */
+bool fast_connect_start(size_t known_connected);
+
+/* Auto-connection attempt over. `timeout` if nobody showed up, in which case
+ * we fall back to scanning for new peers for a while.
+ */
+void fast_connect_done(bool timeout);
+
+#endif /* FAST_CONNECT_H_ */
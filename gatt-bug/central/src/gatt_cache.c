@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/bluetooth/bluetooth.h>
+
+#include "gatt_cache.h"
+
+#define SUBTREE "gcache"
+
+/* "gcache/" + address type and value in hex */
+#define KEY_LEN (sizeof(SUBTREE "/") + 2 * sizeof(bt_addr_le_t))
+
+struct cache_slot {
+	bool used;
+	bt_addr_le_t addr;
+	struct gatt_cache_entry entry;
+};
+
+static struct cache_slot slots[CONFIG_CENTRAL_GATT_CACHE_SIZE];
+static size_t next_victim;
+static K_MUTEX_DEFINE(lock);
+
+static struct cache_slot *find(const bt_addr_le_t *addr)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(slots); i++) {
+		if (slots[i].used && bt_addr_le_eq(&slots[i].addr, addr)) {
+			return &slots[i];
+		}
+	}
+
+	return NULL;
+}
+
+static struct cache_slot *alloc(const bt_addr_le_t *addr)
+{
+	struct cache_slot *slot = find(addr);
+
+	if (slot) {
+		return slot;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(slots); i++) {
+		if (!slots[i].used) {
+			slot = &slots[i];
+			break;
+		}
+	}
+
+	if (!slot) {
+		/* Full, overwrite the oldest entries first */
+		slot = &slots[next_victim];
+		next_victim = (next_victim + 1) % ARRAY_SIZE(slots);
+	}
+
+	slot->used = true;
+	bt_addr_le_copy(&slot->addr, addr);
+
+	return slot;
+}
+
+static int cache_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+	struct gatt_cache_entry entry;
+	bt_addr_le_t addr;
+	ssize_t ret;
+
+	if (settings_name_next(name, NULL) != 2 * sizeof(addr) ||
+	    hex2bin(name, 2 * sizeof(addr), (uint8_t *)&addr, sizeof(addr)) != sizeof(addr)) {
+		return -EINVAL;
+	}
+
+	if (len != sizeof(entry)) {
+		return -EINVAL;
+	}
+
+	ret = read_cb(cb_arg, &entry, sizeof(entry));
+	if (ret < 0) {
+		return ret;
+	}
+
+	k_mutex_lock(&lock, K_FOREVER);
+	alloc(&addr)->entry = entry;
+	k_mutex_unlock(&lock);
+
+	return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(gatt_cache, SUBTREE, NULL, cache_set, NULL, NULL);
+
+int gatt_cache_init(void)
+{
+	int err;
+
+	err = settings_subsys_init();
+	if (err) {
+		return err;
+	}
+
+	return settings_load_subtree(SUBTREE);
+}
+
+int gatt_cache_get(const bt_addr_le_t *addr, struct gatt_cache_entry *entry)
+{
+	struct cache_slot *slot;
+	int err = -ENOENT;
+
+	k_mutex_lock(&lock, K_FOREVER);
+
+	slot = find(addr);
+	if (slot) {
+		*entry = slot->entry;
+		err = 0;
+	}
+
+	k_mutex_unlock(&lock);
+
+	return err;
+}
+
+int gatt_cache_store(const bt_addr_le_t *addr, const struct gatt_cache_entry *entry)
+{
+	char key[KEY_LEN];
+	size_t len;
+
+	k_mutex_lock(&lock, K_FOREVER);
+	alloc(addr)->entry = *entry;
+	k_mutex_unlock(&lock);
+
+	len = snprintk(key, sizeof(key), SUBTREE "/");
+	bin2hex((const uint8_t *)addr, sizeof(*addr), &key[len], sizeof(key) - len);
+
+	return settings_save_one(key, entry, sizeof(*entry));
+}
+
+void gatt_cache_foreach(void (*func)(const bt_addr_le_t *addr, void *user_data),
+			void *user_data)
+{
+	k_mutex_lock(&lock, K_FOREVER);
+
+	for (size_t i = 0; i < ARRAY_SIZE(slots); i++) {
+		if (slots[i].used) {
+			func(&slots[i].addr, user_data);
+		}
+	}
+
+	k_mutex_unlock(&lock);
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef GATT_CACHE_H_
+#define GATT_CACHE_H_
+
+#include <stdint.h>
+#include <zephyr/bluetooth/addr.h>
+#include <zephyr/bluetooth/uuid.h>
+
+#define GATT_CACHE_HASH_LEN 16
+
+struct gatt_cache_entry {
+	/* GATT Database Hash the handles are valid for */
+	uint8_t db_hash[GATT_CACHE_HASH_LEN];
+	/* Characteristic the handles are for, as a string: builds of the
+	 * central subscribing to another one must not use them
+	 */
+	char chrc_uuid[BT_UUID_STR_LEN];
+	uint16_t value_handle;
+	uint16_t ccc_handle;
+};
+
+/* Load the persisted entries. Call after bt_enable(). */
+int gatt_cache_init(void);
+
+/* Copy the entry of `addr` into `entry`. Returns -ENOENT if there is none. */
+int gatt_cache_get(const bt_addr_le_t *addr, struct gatt_cache_entry *entry);
+
+/* Add or replace the entry of `addr`, and persist it */
+int gatt_cache_store(const bt_addr_le_t *addr, const struct gatt_cache_entry *entry);
+
+/* Call `func` with the address of every cached peer */
+void gatt_cache_foreach(void (*func)(const bt_addr_le_t *addr, void *user_data),
+			void *user_data);
+
+#endif /* GATT_CACHE_H_ */
@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include "conn_stats.h"
+#include "link_tuning.h"
+#include "sim_time.h"
+
+enum step {
+	STEP_PHY,
+	STEP_DATA_LEN,
+	STEP_MTU,
+	STEP_CONN_PARAM,
+	STEP_DONE,
+};
+
+static const char *const step_names[STEP_DONE] = {
+	[STEP_PHY] = "PHY update",
+	[STEP_DATA_LEN] = "data length update",
+	[STEP_MTU] = "MTU exchange",
+	[STEP_CONN_PARAM] = "connection parameter update",
+};
+
+static const enum conn_stat step_stats[STEP_DONE] = {
+	[STEP_PHY] = CONN_STAT_PHY_UPDATE,
+	[STEP_DATA_LEN] = CONN_STAT_DATA_LEN_UPDATE,
+	[STEP_MTU] = CONN_STAT_MTU_EXCHANGE,
+	[STEP_CONN_PARAM] = CONN_STAT_CONN_PARAM_UPDATE,
+};
+
+/* Per-connection state, indexed by bt_conn_index() */
+struct link {
+	struct bt_conn *conn;
+	link_tuning_done_t done;
+	enum step step;
+	int64_t start_us;
+	int64_t step_start_us;
+	struct bt_gatt_exchange_params mtu_params;
+	struct k_work_delayable timeout_work;
+};
+
+static struct link links[CONFIG_BT_MAX_CONN];
+
+static struct link *link_get(struct bt_conn *conn)
+{
+	return &links[bt_conn_index(conn)];
+}
+
+static void print_link(struct bt_conn *conn)
+{
+	struct bt_conn_info info;
+
+	if (bt_conn_get_info(conn, &info)) {
+		return;
+	}
+
+	printk("[LINK] conn %u: PHY tx %u rx %u, data length tx %u rx %u, ATT MTU %u, "
+	       "interval %u us, latency %u, timeout %u ms\n",
+	       bt_conn_index(conn), info.le.phy->tx_phy, info.le.phy->rx_phy,
+	       info.le.data_len->tx_max_len, info.le.data_len->rx_max_len,
+	       bt_gatt_get_mtu(conn), info.le.interval * 1250U, info.le.latency,
+	       info.le.timeout * 10U);
+}
+
+static void mtu_exchanged(struct bt_conn *conn, uint8_t err,
+			  struct bt_gatt_exchange_params *params);
+
+/* Returns 0 when the step is in progress and will complete with a callback,
+ * -EALREADY when there is nothing to do, or another error.
+ */
+static int step_start(struct link *link)
+{
+	struct bt_conn *conn = link->conn;
+	struct bt_conn_info info;
+	int err;
+
+	err = bt_conn_get_info(conn, &info);
+	if (err) {
+		return err;
+	}
+
+	/* The controller doesn't always report procedures that didn't change
+	 * anything, so skip those.
+	 */
+	switch (link->step) {
+	case STEP_PHY:
+		if (!IS_ENABLED(CONFIG_CENTRAL_LINK_TUNING_PHY_2M) ||
+		    (info.le.phy->tx_phy == BT_GAP_LE_PHY_2M &&
+		     info.le.phy->rx_phy == BT_GAP_LE_PHY_2M)) {
+			return -EALREADY;
+		}
+
+		return bt_conn_le_phy_update(conn, BT_CONN_LE_PHY_PARAM_2M);
+
+	case STEP_DATA_LEN:
+		if (!IS_ENABLED(CONFIG_CENTRAL_LINK_TUNING_DATA_LEN) ||
+		    info.le.data_len->tx_max_len >= BT_GAP_DATA_LEN_MAX) {
+			return -EALREADY;
+		}
+
+		return bt_conn_le_data_len_update(conn, BT_LE_DATA_LEN_PARAM_MAX);
+
+	case STEP_MTU:
+		if (!IS_ENABLED(CONFIG_CENTRAL_LINK_TUNING_MTU)) {
+			return -EALREADY;
+		}
+
+		link->mtu_params.func = mtu_exchanged;
+
+		/* -EALREADY if it was already exchanged */
+		return bt_gatt_exchange_mtu(conn, &link->mtu_params);
+
+	case STEP_CONN_PARAM:
+		if (!IS_ENABLED(CONFIG_CENTRAL_LINK_TUNING_CONN_PARAM) ||
+		    (info.le.interval == CONFIG_CENTRAL_LINK_TUNING_INTERVAL &&
+		     info.le.latency == CONFIG_CENTRAL_LINK_TUNING_LATENCY &&
+		     info.le.timeout == CONFIG_CENTRAL_LINK_TUNING_TIMEOUT)) {
+			return -EALREADY;
+		}
+
+		return bt_conn_le_param_update(conn,
+					       BT_LE_CONN_PARAM(CONFIG_CENTRAL_LINK_TUNING_INTERVAL,
+								CONFIG_CENTRAL_LINK_TUNING_INTERVAL,
+								CONFIG_CENTRAL_LINK_TUNING_LATENCY,
+								CONFIG_CENTRAL_LINK_TUNING_TIMEOUT));
+
+	default:
+		return -EINVAL;
+	}
+}
+
+/* Run the steps from the current one until one has to wait for its
+ * completion callback.
+ */
+static void steps_run(struct link *link)
+{
+	int err;
+
+	for (; link->step < STEP_DONE; link->step++) {
+		link->step_start_us = sim_time_us();
+
+		err = step_start(link);
+		if (!err) {
+			k_work_reschedule(&link->timeout_work,
+					  K_MSEC(CONFIG_CENTRAL_LINK_TUNING_STEP_TIMEOUT_MS));
+			return;
+		}
+
+		if (err != -EALREADY) {
+			printk("[LINK] conn %u: %s failed (err %d)\n",
+			       bt_conn_index(link->conn), step_names[link->step], err);
+		}
+	}
+
+	k_work_cancel_delayable(&link->timeout_work);
+
+	conn_stats_record(CONN_STAT_LINK_TUNING, sim_time_us() - link->start_us);
+	print_link(link->conn);
+
+	link->done(link->conn);
+}
+
+static void step_complete(struct bt_conn *conn, enum step step)
+{
+	struct link *link = link_get(conn);
+	int64_t us;
+
+	if (link->conn != conn || link->step != step) {
+		/* Not started by us (e.g. peer initiated) */
+		return;
+	}
+
+	us = sim_time_us() - link->step_start_us;
+	printk("[LINK] conn %u: %s took %lld us\n", bt_conn_index(conn), step_names[step], us);
+	conn_stats_record(step_stats[step], us);
+
+	link->step++;
+	steps_run(link);
+}
+
+static void timeout_work_handler(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct link *link = CONTAINER_OF(dwork, struct link, timeout_work);
+
+	if (!link->conn || link->step >= STEP_DONE) {
+		return;
+	}
+
+	printk("[LINK] conn %u: %s timed out\n", bt_conn_index(link->conn),
+	       step_names[link->step]);
+
+	link->step++;
+	steps_run(link);
+}
+
+static void mtu_exchanged(struct bt_conn *conn, uint8_t err,
+			  struct bt_gatt_exchange_params *params)
+{
+	if (err) {
+		printk("[LINK] conn %u: MTU exchange failed (err %u)\n", bt_conn_index(conn), err);
+	}
+
+	step_complete(conn, STEP_MTU);
+}
+
+static void le_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *param)
+{
+	step_complete(conn, STEP_PHY);
+}
+
+static void le_data_len_updated(struct bt_conn *conn, struct bt_conn_le_data_len_info *info)
+{
+	step_complete(conn, STEP_DATA_LEN);
+}
+
+static void le_param_updated(struct bt_conn *conn, uint16_t interval,
+			     uint16_t latency, uint16_t timeout)
+{
+	step_complete(conn, STEP_CONN_PARAM);
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	struct link *link = link_get(conn);
+
+	if (link->conn != conn) {
+		return;
+	}
+
+	k_work_cancel_delayable(&link->timeout_work);
+	link->conn = NULL;
+	link->step = STEP_DONE;
+}
+
+BT_CONN_CB_DEFINE(link_tuning_conn_callbacks) = {
+	.disconnected = disconnected,
+	.le_param_updated = le_param_updated,
+	.le_phy_updated = le_phy_updated,
+	.le_data_len_updated = le_data_len_updated,
+};
+
+void link_tuning_start(struct bt_conn *conn, link_tuning_done_t done)
+{
+	struct link *link = link_get(conn);
+
+	link->conn = conn;
+	link->done = done;
+	link->start_us = sim_time_us();
+	link->step = STEP_PHY;
+
+	steps_run(link);
+}
+
+static int link_tuning_init(void)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(links); i++) {
+		links[i].step = STEP_DONE;
+		k_work_init_delayable(&links[i].timeout_work, timeout_work_handler);
+	}
+
+	return 0;
+}
+
+SYS_INIT(link_tuning_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
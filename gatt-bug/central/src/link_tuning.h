@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef LINK_TUNING_H_
+#define LINK_TUNING_H_
+
+#include <zephyr/bluetooth/conn.h>
+
+typedef void (*link_tuning_done_t)(struct bt_conn *conn);
+
+/* Negotiate 2M PHY, maximum data length, maximum ATT MTU and the configured
+ * connection parameters, one after the other. `done` is called once all the
+ * steps completed, failed or timed out, and not at all if the connection is
+ * lost in the meantime.
+ */
+void link_tuning_start(struct bt_conn *conn, link_tuning_done_t done);
+
+#endif /* LINK_TUNING_H_ */
@@ -16,82 +16,370 @@
 #include <zephyr/bluetooth/hci.h>
 #include <zephyr/bluetooth/conn.h>
 #include <zephyr/bluetooth/uuid.h>
+#include <zephyr/bluetooth/att.h>
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/sys/byteorder.h>
+#include <zephyr/settings/settings.h>
+
+#include "conn_stats.h"
+#include "fast_connect.h"
+#include "gatt_cache.h"
+#include "link_tuning.h"
+#include "ntf_stamp.h"
+#include "ntf_stats.h"
+#include "sim_time.h"
+#include "sim_trace.h"
+#include "traffic_gen_uuid.h"
 
 static void start_scan(void);
 
-static struct bt_conn *default_conn;
+/* Service and notifying characteristic we subscribe to */
+#if defined(CONFIG_CENTRAL_TRAFFIC_SINK)
+static const struct bt_uuid_128 svc_uuid = BT_UUID_INIT_128(TRAFFIC_GEN_UUID_VAL);
+static const struct bt_uuid_128 chrc_uuid = BT_UUID_INIT_128(TRAFFIC_GEN_DATA_UUID_VAL);
+#else
+static const struct bt_uuid_16 svc_uuid = BT_UUID_INIT_16(BT_UUID_HRS_VAL);
+static const struct bt_uuid_16 chrc_uuid = BT_UUID_INIT_16(BT_UUID_HRS_MEASUREMENT_VAL);
+#endif
+static const struct bt_uuid_16 ccc_uuid = BT_UUID_INIT_16(BT_UUID_GATT_CCC_VAL);
+
+/* Per-connection state, indexed by bt_conn_index() */
+struct peer {
+	struct bt_conn *conn;
+
+	struct bt_gatt_discover_params discover_params;
+	struct bt_gatt_subscribe_params subscribe_params;
+	struct bt_gatt_read_params read_params;
+#if defined(CONFIG_BT_GATT_AUTO_DISCOVER_CCC)
+	struct bt_gatt_discover_params ccc_discover_params;
+#endif
+
+	/* GATT Database Hash read on connection, empty if not supported */
+	uint8_t db_hash[GATT_CACHE_HASH_LEN];
+	bool have_db_hash;
+	/* Subscribed using cached handles */
+	bool cached;
+	/* Bonded before this connection: encryption resumes with the stored LTK */
+	bool bonded;
+	/* Link encrypted, GATT started */
+	bool secured;
+	/* CCC write sent, and acknowledged */
+	bool subscribing;
+	bool subscribed;
+
+	uint64_t rx_count;
+	/* Next expected notification sequence number */
+	uint32_t next_seq;
+
+	int64_t found_us;
+	int64_t connected_us;
+
+	struct k_work_delayable disconnect_work;
+#if defined(CONFIG_CENTRAL_EATT)
+	struct k_work_delayable eatt_work;
+	int64_t eatt_deadline_us;
+#endif
+};
+
+static struct peer peers[CONFIG_BT_MAX_CONN];
 
-static struct bt_uuid_16 discover_uuid = BT_UUID_INIT_16(0);
-static struct bt_gatt_discover_params discover_params;
-static struct bt_gatt_subscribe_params subscribe_params;
+/* The host can only initiate one connection at a time. Scanning is paused
+ * while it does and resumed as soon as the connection is established.
+ */
+static bool connecting;
+static int64_t connecting_found_us;
 
 uint64_t total_rx_count; /* This value is exposed to test code */
+/* Notifications from all peers, over all connections */
+uint64_t run_rx_count;
+
+/* Recently disconnected peers, to measure how long they take to come back */
+static struct {
+	bt_addr_le_t addr;
+	int64_t us;
+} lost_links[CONFIG_BT_MAX_CONN];
+static size_t lost_links_next;
+
+static void lost_links_record(const bt_addr_le_t *addr)
+{
+	bt_addr_le_copy(&lost_links[lost_links_next].addr, addr);
+	lost_links[lost_links_next].us = sim_time_us();
+	lost_links_next = (lost_links_next + 1) % ARRAY_SIZE(lost_links);
+}
+
+static void lost_links_found(const bt_addr_le_t *addr)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(lost_links); i++) {
+		if (lost_links[i].us && bt_addr_le_eq(&lost_links[i].addr, addr)) {
+			conn_stats_record(CONN_STAT_RECONNECT, sim_time_us() - lost_links[i].us);
+			lost_links[i].us = 0;
+		}
+	}
+}
+
+static struct peer *peer_get(struct bt_conn *conn)
+{
+	return &peers[bt_conn_index(conn)];
+}
+
+static void peer_reset(struct peer *peer)
+{
+	/* The disconnect work item outlives the connection */
+	peer->conn = NULL;
+	(void)memset(&peer->discover_params, 0, sizeof(peer->discover_params));
+	(void)memset(&peer->subscribe_params, 0, sizeof(peer->subscribe_params));
+	(void)memset(&peer->read_params, 0, sizeof(peer->read_params));
+#if defined(CONFIG_BT_GATT_AUTO_DISCOVER_CCC)
+	(void)memset(&peer->ccc_discover_params, 0, sizeof(peer->ccc_discover_params));
+#endif
+	peer->have_db_hash = false;
+	peer->cached = false;
+	peer->secured = false;
+	peer->subscribing = false;
+	peer->subscribed = false;
+	peer->rx_count = 0U;
+}
+
+static size_t peer_count(void)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < ARRAY_SIZE(peers); i++) {
+		count += peers[i].conn != NULL;
+	}
+
+	return count;
+}
+
+/* Connected peers that are in the Filter Accept List */
+static size_t known_peer_count(void)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < ARRAY_SIZE(peers); i++) {
+		count += peers[i].conn != NULL &&
+			 fast_connect_is_known(bt_conn_get_dst(peers[i].conn));
+	}
+
+	return count;
+}
+
+static void ntf_account(struct peer *peer, const void *data, uint16_t length)
+{
+	int64_t latency_us = -1;
+	uint32_t lost = 0U;
+	int64_t tx_us;
+	uint32_t seq;
+
+	if (ntf_stamp_decode(data, length, &seq, &tx_us)) {
+		latency_us = sim_time_us() - tx_us;
+
+		/* Sequence numbers are only comparable within a subscription */
+		if (peer->rx_count && seq > peer->next_seq) {
+			lost = seq - peer->next_seq;
+		}
+		peer->next_seq = seq + 1U;
+	}
+
+	ntf_stats_record(length, latency_us, lost);
+}
 
 static uint8_t notify_func(struct bt_conn *conn,
 			   struct bt_gatt_subscribe_params *params,
 			   const void *data, uint16_t length)
 {
+	struct peer *peer = CONTAINER_OF(params, struct peer, subscribe_params);
+
+	SIM_TRACE_INSTANT("notify", bt_conn_index(conn), length);
+
 	if (!data) {
 		printk("[UNSUBSCRIBED]\n");
 		params->value_handle = 0U;
 		return BT_GATT_ITER_STOP;
 	}
 
-	printk("[NOTIFICATION] data %p length %u\n", data, length);
+	if (IS_ENABLED(CONFIG_CENTRAL_NTF_STATS)) {
+		ntf_account(peer, data, length);
+	} else {
+		printk("[NOTIFICATION] conn %u data %p length %u\n",
+		       bt_conn_index(conn), data, length);
+	}
+
+	if (!peer->rx_count) {
+		conn_stats_record(peer->cached ? CONN_STAT_FIRST_NTF_CACHED : CONN_STAT_FIRST_NTF,
+				  sim_time_us() - peer->connected_us);
+	}
 
+	peer->rx_count++;
 	total_rx_count++;
+	run_rx_count++;
 
 	return BT_GATT_ITER_CONTINUE;
 }
 
+static void disconnect_work_handler(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct peer *peer = CONTAINER_OF(dwork, struct peer, disconnect_work);
+	int err;
+
+	if (!peer->conn) {
+		return;
+	}
+
+	printk("Disconnecting conn %u\n", bt_conn_index(peer->conn));
+
+	err = bt_conn_disconnect(peer->conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+	if (err) {
+		printk("Disconnect failed (err %d)\n", err);
+	}
+}
+
+static void cache_store(struct bt_conn *conn, struct peer *peer)
+{
+	struct gatt_cache_entry entry = {
+		.value_handle = peer->subscribe_params.value_handle,
+		.ccc_handle = peer->subscribe_params.ccc_handle,
+	};
+	int err;
+
+	if (!IS_ENABLED(CONFIG_CENTRAL_GATT_CACHE) || !peer->have_db_hash) {
+		return;
+	}
+
+	memcpy(entry.db_hash, peer->db_hash, sizeof(entry.db_hash));
+	bt_uuid_to_str(&chrc_uuid.uuid, entry.chrc_uuid, sizeof(entry.chrc_uuid));
+
+	err = gatt_cache_store(bt_conn_get_dst(conn), &entry);
+	if (err) {
+		printk("Failed to store GATT cache (err %d)\n", err);
+	}
+}
+
+static void subscribed(struct bt_conn *conn, uint8_t err,
+		       struct bt_gatt_subscribe_params *params)
+{
+	struct peer *peer = peer_get(conn);
+
+	if (err) {
+		printk("Subscribe failed (ATT err 0x%02x)\n", err);
+		return;
+	}
+
+	if (!params || !params->value) {
+		/* Unsubscribed */
+		return;
+	}
+
+	peer->subscribed = true;
+
+	printk("[SUBSCRIBED] conn %u%s\n", bt_conn_index(conn), peer->cached ? " (cached)" : "");
+	conn_stats_record(peer->cached ? CONN_STAT_SUBSCRIBE_CACHED : CONN_STAT_SUBSCRIBE,
+			  sim_time_us() - peer->connected_us);
+
+	if (!peer->cached) {
+		cache_store(conn, peer);
+	}
+
+	if (CONFIG_CENTRAL_RECONNECT_S > 0) {
+		k_work_schedule(&peer->disconnect_work, K_SECONDS(CONFIG_CENTRAL_RECONNECT_S));
+	}
+}
+
+static void subscribe(struct bt_conn *conn, struct peer *peer)
+{
+	int err;
+
+	if (peer->subscribing) {
+		return;
+	}
+
+	peer->subscribe_params.notify = notify_func;
+	peer->subscribe_params.subscribe = subscribed;
+	peer->subscribe_params.value = BT_GATT_CCC_NOTIFY;
+	/* Bonded or not, have the host drop the subscription on
+	 * disconnection: peer_reset() clears these params, they must not be
+	 * left in its list. We subscribe again on every connection anyway.
+	 */
+	atomic_set_bit(peer->subscribe_params.flags, BT_GATT_SUBSCRIBE_FLAG_VOLATILE);
+
+#if defined(CONFIG_BT_GATT_AUTO_DISCOVER_CCC)
+	if (!peer->subscribe_params.ccc_handle) {
+		/* Have the host find the CCC before writing it */
+		peer->subscribe_params.disc_params = &peer->ccc_discover_params;
+		peer->subscribe_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+	}
+#endif
+
+	err = bt_gatt_subscribe(conn, &peer->subscribe_params);
+	if (err == -EALREADY) {
+		/* Still in the host's subscription list: nothing is sent and
+		 * no callback comes, the CCC is already written.
+		 */
+		peer->subscribing = true;
+		subscribed(conn, 0, &peer->subscribe_params);
+		return;
+	}
+
+	if (err) {
+		printk("Subscribe failed (err %d)\n", err);
+		return;
+	}
+
+	peer->subscribing = true;
+}
+
 static uint8_t discover_func(struct bt_conn *conn,
 			     const struct bt_gatt_attr *attr,
 			     struct bt_gatt_discover_params *params)
 {
+	struct peer *peer = CONTAINER_OF(params, struct peer, discover_params);
 	int err;
 
+	SIM_TRACE_INSTANT("discover", bt_conn_index(conn), attr ? attr->handle : 0);
+
 	if (!attr) {
 		printk("Discover complete\n");
 		(void)memset(params, 0, sizeof(*params));
 		return BT_GATT_ITER_STOP;
 	}
 
-	printk("[ATTRIBUTE] handle %u\n", attr->handle);
+	printk("[ATTRIBUTE] conn %u handle %u\n", bt_conn_index(conn), attr->handle);
 
-	if (!bt_uuid_cmp(discover_params.uuid, BT_UUID_HRS)) {
-		memcpy(&discover_uuid, BT_UUID_HRS_MEASUREMENT, sizeof(discover_uuid));
-		discover_params.uuid = &discover_uuid.uuid;
-		discover_params.start_handle = attr->handle + 1;
-		discover_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+	if (!bt_uuid_cmp(params->uuid, &svc_uuid.uuid)) {
+		params->uuid = &chrc_uuid.uuid;
+		params->start_handle = attr->handle + 1;
+		params->type = BT_GATT_DISCOVER_CHARACTERISTIC;
 
-		err = bt_gatt_discover(conn, &discover_params);
+		err = bt_gatt_discover(conn, params);
 		if (err) {
 			printk("Discover failed (err %d)\n", err);
 		}
-	} else if (!bt_uuid_cmp(discover_params.uuid,
-				BT_UUID_HRS_MEASUREMENT)) {
-		memcpy(&discover_uuid, BT_UUID_GATT_CCC, sizeof(discover_uuid));
-		discover_params.uuid = &discover_uuid.uuid;
-		discover_params.start_handle = attr->handle + 2;
-		subscribe_params.value_handle = bt_gatt_attr_value_handle(attr);
-
-		err = bt_gatt_discover(conn, &discover_params);
+	} else if (!bt_uuid_cmp(params->uuid, &chrc_uuid.uuid)) {
+		if (peer->subscribing) {
+			/* Already subscribed from the GATT cache */
+			return BT_GATT_ITER_STOP;
+		}
+
+		peer->subscribe_params.value_handle = bt_gatt_attr_value_handle(attr);
+
+		if (IS_ENABLED(CONFIG_CENTRAL_EATT)) {
+			/* The CCC is discovered as part of the subscription */
+			subscribe(conn, peer);
+			return BT_GATT_ITER_STOP;
+		}
+
+		params->uuid = &ccc_uuid.uuid;
+		params->start_handle = attr->handle + 2;
+
+		err = bt_gatt_discover(conn, params);
 		if (err) {
 			printk("Discover failed (err %d)\n", err);
 		}
 	} else {
-		subscribe_params.notify = notify_func;
-		subscribe_params.value = BT_GATT_CCC_NOTIFY;
-		subscribe_params.ccc_handle = attr->handle;
-
-		err = bt_gatt_subscribe(conn, &subscribe_params);
-		if (err && err != -EALREADY) {
-			printk("Subscribe failed (err %d)\n", err);
-		} else {
-			printk("[SUBSCRIBED]\n");
-		}
+		peer->subscribe_params.ccc_handle = attr->handle;
+
+		subscribe(conn, peer);
 
 		return BT_GATT_ITER_STOP;
 	}
@@ -99,90 +387,214 @@ static uint8_t discover_func(struct bt_conn *conn,
 	return BT_GATT_ITER_STOP;
 }
 
-static bool eir_found(struct bt_data *data, void *user_data)
+static void discover(struct bt_conn *conn, struct peer *peer)
+{
+	int err;
+
+	peer->discover_params.uuid = &svc_uuid.uuid;
+	peer->discover_params.func = discover_func;
+	peer->discover_params.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+	peer->discover_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+	peer->discover_params.type = BT_GATT_DISCOVER_PRIMARY;
+
+	err = bt_gatt_discover(conn, &peer->discover_params);
+	if (err) {
+		printk("Discover failed(err %d)\n", err);
+	}
+}
+
+/* The characteristic UUID is unique in the peer's database, so it can be
+ * looked up directly instead of going through its service first.
+ */
+static void discover_chrc(struct bt_conn *conn, struct peer *peer)
 {
-	bt_addr_le_t *addr = user_data;
-	int i;
+	int err;
 
-	printk("[AD]: %u data_len %u\n", data->type, data->data_len);
+	peer->discover_params.uuid = &chrc_uuid.uuid;
+	peer->discover_params.func = discover_func;
+	peer->discover_params.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+	peer->discover_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+	peer->discover_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+
+	err = bt_gatt_discover(conn, &peer->discover_params);
+	if (err) {
+		printk("Discover failed(err %d)\n", err);
+	}
+}
+
+/* Same database, and handles of the characteristic we subscribe to */
+static bool cache_entry_valid(const struct peer *peer, const struct gatt_cache_entry *entry)
+{
+	char uuid[BT_UUID_STR_LEN];
 
-	switch (data->type) {
-	case BT_DATA_UUID16_SOME:
-	case BT_DATA_UUID16_ALL:
-		if (data->data_len % sizeof(uint16_t) != 0U) {
-			printk("AD malformed\n");
-			return true;
+	bt_uuid_to_str(&chrc_uuid.uuid, uuid, sizeof(uuid));
+
+	return !memcmp(entry->db_hash, peer->db_hash, sizeof(entry->db_hash)) &&
+	       !strncmp(entry->chrc_uuid, uuid, sizeof(entry->chrc_uuid));
+}
+
+static uint8_t db_hash_read_func(struct bt_conn *conn, uint8_t err,
+				 struct bt_gatt_read_params *params,
+				 const void *data, uint16_t length)
+{
+	struct peer *peer = CONTAINER_OF(params, struct peer, read_params);
+	struct gatt_cache_entry entry;
+
+	if (!err && data && length == sizeof(peer->db_hash)) {
+		memcpy(peer->db_hash, data, sizeof(peer->db_hash));
+		peer->have_db_hash = true;
+	}
+
+	if (IS_ENABLED(CONFIG_CENTRAL_EATT) && peer->subscribing) {
+		/* The concurrent discovery won the race */
+		if (peer->subscribed) {
+			cache_store(conn, peer);
 		}
+	} else if (peer->have_db_hash &&
+	    !gatt_cache_get(bt_conn_get_dst(conn), &entry) &&
+	    cache_entry_valid(peer, &entry)) {
+		/* Database unchanged since last time, skip discovery */
+		peer->cached = true;
+		peer->subscribe_params.value_handle = entry.value_handle;
+		peer->subscribe_params.ccc_handle = entry.ccc_handle;
+		subscribe(conn, peer);
+	} else if (!IS_ENABLED(CONFIG_CENTRAL_EATT)) {
+		discover(conn, peer);
+	}
 
-		for (i = 0; i < data->data_len; i += sizeof(uint16_t)) {
-			struct bt_conn_le_create_param *create_param;
-			struct bt_le_conn_param *param;
-			const struct bt_uuid *uuid;
-			uint16_t u16;
-			int err;
-
-			memcpy(&u16, &data->data[i], sizeof(u16));
-			uuid = BT_UUID_DECLARE_16(sys_le16_to_cpu(u16));
-			if (bt_uuid_cmp(uuid, BT_UUID_HRS)) {
-				continue;
-			}
+	return BT_GATT_ITER_STOP;
+}
 
-			err = bt_le_scan_stop();
-			if (err) {
-				printk("Stop LE scan failed (err %d)\n", err);
-				continue;
-			}
+static void connect_peer(const bt_addr_le_t *addr)
+{
+	struct bt_conn_le_create_param *create_param;
+	struct bt_le_conn_param *param;
+	struct bt_conn *conn;
+	int err;
 
-			printk("Creating connection with Coded PHY support\n");
-			param = BT_LE_CONN_PARAM_DEFAULT;
-			create_param = BT_CONN_LE_CREATE_CONN;
-			create_param->options |= BT_CONN_LE_OPT_CODED;
-			err = bt_conn_le_create(addr, create_param, param,
-						&default_conn);
-			if (err) {
-				printk("Create connection with Coded PHY support failed (err %d)\n",
-				       err);
-
-				printk("Creating non-Coded PHY connection\n");
-				create_param->options &= ~BT_CONN_LE_OPT_CODED;
-				err = bt_conn_le_create(addr, create_param,
-							param, &default_conn);
-				if (err) {
-					printk("Create connection failed (err %d)\n", err);
-					start_scan();
-				}
-			}
+	err = bt_le_scan_stop();
+	if (err) {
+		printk("Stop LE scan failed (err %d)\n", err);
+		return;
+	}
+
+	connecting = true;
+	connecting_found_us = sim_time_us();
+
+	printk("Creating connection with Coded PHY support\n");
+	param = BT_LE_CONN_PARAM_DEFAULT;
+	create_param = BT_CONN_LE_CREATE_CONN;
+	create_param->options |= BT_CONN_LE_OPT_CODED;
+	err = bt_conn_le_create(addr, create_param, param, &conn);
+	if (err) {
+		printk("Create connection with Coded PHY support failed (err %d)\n",
+		       err);
+
+		printk("Creating non-Coded PHY connection\n");
+		create_param->options &= ~BT_CONN_LE_OPT_CODED;
+		err = bt_conn_le_create(addr, create_param, param, &conn);
+		if (err) {
+			printk("Create connection failed (err %d)\n", err);
+			connecting = false;
+			start_scan();
+			return;
+		}
+	}
+
+	/* Keep the reference until disconnected */
+	peer_get(conn)->conn = conn;
+}
 
+/* Look for a 16-bit service UUID in the AD, without going through
+ * bt_data_parse() and without looking at any other AD type.
+ */
+static bool ad_has_uuid16(const struct net_buf_simple *ad, uint16_t uuid)
+{
+	const uint8_t *p = ad->data;
+	size_t len = ad->len;
+
+	while (len > 1U) {
+		/* Field: length (type + data), type, data */
+		uint8_t field_len = p[0];
+
+		if (!field_len || field_len >= len) {
+			/* End of significant part, or malformed */
 			return false;
 		}
+
+		if (p[1] == BT_DATA_UUID16_SOME || p[1] == BT_DATA_UUID16_ALL) {
+			for (size_t i = 2U; i + 1U <= field_len; i += sizeof(uint16_t)) {
+				if (sys_get_le16(&p[i]) == uuid) {
+					return true;
+				}
+			}
+		}
+
+		p += field_len + 1U;
+		len -= field_len + 1U;
 	}
 
-	return true;
+	return false;
 }
 
 static void device_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
 			 struct net_buf_simple *ad)
 {
-	char dev[BT_ADDR_LE_STR_LEN];
+	struct bt_conn *conn;
 
-	bt_addr_le_to_str(addr, dev, sizeof(dev));
-	printk("[DEVICE]: %s, AD evt type %u, AD data len %u, RSSI %i\n",
-	       dev, type, ad->len, rssi);
+	if (connecting) {
+		/* Reports still queued from before the scanner was stopped */
+		return;
+	}
+
+	if (IS_ENABLED(CONFIG_CENTRAL_VERBOSE)) {
+		char dev[BT_ADDR_LE_STR_LEN];
+
+		bt_addr_le_to_str(addr, dev, sizeof(dev));
+		printk("[DEVICE]: %s, AD evt type %u, AD data len %u, RSSI %i\n",
+		       dev, type, ad->len, rssi);
+	}
 
 	/* We're only interested in legacy connectable events or
 	 * possible extended advertising that are connectable.
 	 */
-	if (type == BT_GAP_ADV_TYPE_ADV_IND ||
-	    type == BT_GAP_ADV_TYPE_ADV_DIRECT_IND ||
-	    type == BT_GAP_ADV_TYPE_EXT_ADV) {
-		bt_data_parse(ad, eir_found, (void *)addr);
+	if (type != BT_GAP_ADV_TYPE_ADV_IND &&
+	    type != BT_GAP_ADV_TYPE_ADV_DIRECT_IND &&
+	    type != BT_GAP_ADV_TYPE_EXT_ADV) {
+		return;
 	}
+
+	if (!ad_has_uuid16(ad, BT_UUID_HRS_VAL)) {
+		return;
+	}
+
+	conn = bt_conn_lookup_addr_le(BT_ID_DEFAULT, addr);
+	if (conn) {
+		/* Already connected (or connecting) */
+		bt_conn_unref(conn);
+		return;
+	}
+
+	connect_peer(addr);
 }
 
 static void start_scan(void)
 {
 	int err;
 
+	if (connecting || peer_count() >= CONFIG_BT_MAX_CONN) {
+		return;
+	}
+
+	/* Known peers first, the controller connects them as soon as it
+	 * sees them.
+	 */
+	if (IS_ENABLED(CONFIG_CENTRAL_FAST_CONNECT) && fast_connect_start(known_peer_count())) {
+		connecting = true;
+		connecting_found_us = sim_time_us();
+		return;
+	}
+
 	/* Use active scanning and disable duplicate filtering to handle any
 	 * devices that might update their advertising data at runtime. */
 	struct bt_le_scan_param scan_param = {
@@ -193,6 +605,10 @@ static void start_scan(void)
 	};
 
 	err = bt_le_scan_start(&scan_param, device_found);
+	if (err == -EALREADY) {
+		return;
+	}
+
 	if (err) {
 		printk("Scanning with Coded PHY support failed (err %d)\n", err);
 
@@ -208,57 +624,240 @@ static void start_scan(void)
 	printk("Scanning successfully started\n");
 }
 
+/* Start using the link: find the characteristic and subscribe to it */
+static void gatt_start(struct bt_conn *conn)
+{
+	struct peer *peer = peer_get(conn);
+	int err;
+
+	if (IS_ENABLED(CONFIG_CENTRAL_GATT_CACHE)) {
+		/* Reading the hash first also makes us change-aware, see Core
+		 * Spec Vol 3, Part G, 2.5.2.1 Robust Caching.
+		 */
+		peer->read_params.func = db_hash_read_func;
+		peer->read_params.handle_count = 0;
+		peer->read_params.by_uuid.uuid = BT_UUID_GATT_DB_HASH;
+		peer->read_params.by_uuid.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+		peer->read_params.by_uuid.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+
+		err = bt_gatt_read(conn, &peer->read_params);
+		if (err) {
+			printk("Database Hash read failed (err %d)\n", err);
+		} else if (!IS_ENABLED(CONFIG_CENTRAL_EATT)) {
+			/* Discovery, if needed, starts once the hash is known */
+			return;
+		}
+	}
+
+	if (IS_ENABLED(CONFIG_CENTRAL_EATT)) {
+		/* Runs concurrently with the hash read, on another bearer */
+		discover_chrc(conn, peer);
+	} else {
+		discover(conn, peer);
+	}
+}
+
+#if defined(CONFIG_CENTRAL_EATT)
+#define EATT_POLL_MS 5
+
+/* Enhanced bearers are set up by the host once the link is encrypted. Wait
+ * for them before using GATT, so the requests can be spread over them.
+ */
+static void eatt_work_handler(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct peer *peer = CONTAINER_OF(dwork, struct peer, eatt_work);
+	int count;
+
+	if (!peer->conn) {
+		return;
+	}
+
+	count = bt_eatt_count(peer->conn);
+	if (count < CONFIG_BT_EATT_MAX && sim_time_us() < peer->eatt_deadline_us) {
+		k_work_schedule(dwork, K_MSEC(EATT_POLL_MS));
+		return;
+	}
+
+	printk("conn %u: %d EATT bearers\n", bt_conn_index(peer->conn), count);
+	conn_stats_record(CONN_STAT_EATT, sim_time_us() - peer->connected_us);
+
+	gatt_start(peer->conn);
+}
+#endif /* CONFIG_CENTRAL_EATT */
+
+#if defined(CONFIG_CENTRAL_SECURITY)
+/* Link encrypted, at connection or later: start using it */
+static void link_secured(struct bt_conn *conn)
+{
+	struct peer *peer = peer_get(conn);
+
+	peer->secured = true;
+
+	conn_stats_record(peer->bonded ? CONN_STAT_RESUME : CONN_STAT_SECURITY,
+			  sim_time_us() - peer->connected_us);
+
+#if defined(CONFIG_CENTRAL_EATT)
+	peer->eatt_deadline_us = sim_time_us() + CONFIG_CENTRAL_EATT_WAIT_MS * USEC_PER_MSEC;
+	k_work_reschedule(&peer->eatt_work, K_NO_WAIT);
+#else
+	gatt_start(conn);
+#endif
+}
+
+static void security_changed(struct bt_conn *conn, bt_security_t level,
+			     enum bt_security_err err)
+{
+	struct peer *peer = peer_get(conn);
+
+	if (peer->conn != conn || peer->secured || peer->subscribing) {
+		return;
+	}
+
+	if (err == BT_SECURITY_ERR_PIN_OR_KEY_MISSING && peer->bonded) {
+		/* The peer lost its keys, e.g. it started from a blank flash.
+		 * Drop ours too, which disconnects: the next connection pairs.
+		 */
+		printk("conn %u: peer lost the bond, unpairing\n", bt_conn_index(conn));
+		(void)bt_unpair(BT_ID_DEFAULT, bt_conn_get_dst(conn));
+		return;
+	}
+
+	if (err) {
+		printk("Security failed: level %u err %d\n", level, err);
+		gatt_start(conn);
+		return;
+	}
+
+	link_secured(conn);
+}
+
+/* Called once the keys are distributed, after security_changed() */
+static void pairing_complete(struct bt_conn *conn, bool bonded)
+{
+	struct peer *peer = peer_get(conn);
+
+	if (peer->conn != conn) {
+		return;
+	}
+
+	conn_stats_record(CONN_STAT_PAIRING, sim_time_us() - peer->connected_us);
+}
+
+static struct bt_conn_auth_info_cb auth_info_cb = {
+	.pairing_complete = pairing_complete,
+};
+#endif /* CONFIG_CENTRAL_SECURITY */
+
+/* Link set up (and tuned), start the GATT procedures */
+static void link_ready(struct bt_conn *conn)
+{
+#if defined(CONFIG_CENTRAL_SECURITY)
+	int err;
+
+	if (peer_get(conn)->secured) {
+		/* Encrypted while the link was being tuned */
+		return;
+	}
+
+	if (bt_conn_get_security(conn) >= BT_SECURITY_L2) {
+		/* No security_changed() is coming */
+		link_secured(conn);
+		return;
+	}
+
+	/* GATT starts once the link is encrypted, see security_changed() */
+	err = bt_conn_set_security(conn, BT_SECURITY_L2);
+	if (!err) {
+		return;
+	}
+
+	printk("Failed to set security (err %d)\n", err);
+#endif
+
+	gatt_start(conn);
+}
+
 static void connected(struct bt_conn *conn, uint8_t conn_err)
 {
+	struct peer *peer = peer_get(conn);
 	char addr[BT_ADDR_LE_STR_LEN];
-	int err;
 
 	bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
 
+	connecting = false;
+
+	if (IS_ENABLED(CONFIG_CENTRAL_FAST_CONNECT)) {
+		/* Nobody showed up in time, anything else is retried */
+		fast_connect_done(conn_err == BT_HCI_ERR_UNKNOWN_CONN_ID);
+	}
+
 	if (conn_err) {
 		printk("Failed to connect to %s (%u)\n", addr, conn_err);
 
-		bt_conn_unref(default_conn);
-		default_conn = NULL;
+		if (peer->conn) {
+			bt_conn_unref(peer->conn);
+			peer->conn = NULL;
+		}
 
 		start_scan();
 		return;
 	}
 
-	printk("Connected: %s\n", addr);
+	if (!peer->conn) {
+		/* Auto-connected, bt_conn_le_create_auto() gives no reference */
+		peer->conn = bt_conn_ref(conn);
+	}
+
+	printk("Connected: %s (conn %u, %u/%u)\n", addr, bt_conn_index(conn),
+	       peer_count(), CONFIG_BT_MAX_CONN);
+
+	lost_links_found(bt_conn_get_dst(conn));
 
+	if (IS_ENABLED(CONFIG_CENTRAL_FAST_CONNECT)) {
+		fast_connect_learn(bt_conn_get_dst(conn));
+	}
+
+	peer->found_us = connecting_found_us;
+	peer->connected_us = sim_time_us();
+	peer->rx_count = 0U;
+	/* Counts from the latest connection, as it always did */
 	total_rx_count = 0U;
+	peer->bonded = IS_ENABLED(CONFIG_CENTRAL_SECURITY) &&
+		       bt_le_bond_exists(BT_ID_DEFAULT, bt_conn_get_dst(conn));
+	conn_stats_record(CONN_STAT_SETUP, peer->connected_us - peer->found_us);
 
-	if (conn == default_conn) {
-		memcpy(&discover_uuid, BT_UUID_HRS, sizeof(discover_uuid));
-		discover_params.uuid = &discover_uuid.uuid;
-		discover_params.func = discover_func;
-		discover_params.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
-		discover_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
-		discover_params.type = BT_GATT_DISCOVER_PRIMARY;
+	/* Look for more peripherals while this one is being discovered */
+	start_scan();
 
-		err = bt_gatt_discover(default_conn, &discover_params);
-		if (err) {
-			printk("Discover failed(err %d)\n", err);
-			return;
-		}
+	if (IS_ENABLED(CONFIG_CENTRAL_LINK_TUNING)) {
+		link_tuning_start(conn, link_ready);
+	} else {
+		link_ready(conn);
 	}
 }
 
 static void disconnected(struct bt_conn *conn, uint8_t reason)
 {
+	struct peer *peer = peer_get(conn);
 	char addr[BT_ADDR_LE_STR_LEN];
 
 	bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
 
 	printk("Disconnected: %s, reason 0x%02x %s\n", addr, reason, bt_hci_err_to_str(reason));
 
-	if (default_conn != conn) {
+	if (peer->conn != conn) {
 		return;
 	}
 
-	bt_conn_unref(default_conn);
-	default_conn = NULL;
+	k_work_cancel_delayable(&peer->disconnect_work);
+	lost_links_record(bt_conn_get_dst(conn));
+#if defined(CONFIG_CENTRAL_EATT)
+	k_work_cancel_delayable(&peer->eatt_work);
+#endif
+
+	bt_conn_unref(peer->conn);
+	peer_reset(peer);
 
 	start_scan();
 }
@@ -266,6 +865,9 @@ static void disconnected(struct bt_conn *conn, uint8_t reason)
 BT_CONN_CB_DEFINE(conn_callbacks) = {
 	.connected = connected,
 	.disconnected = disconnected,
+#if defined(CONFIG_CENTRAL_SECURITY)
+	.security_changed = security_changed,
+#endif
 };
 
 int main(void)
@@ -280,6 +882,36 @@ int main(void)
 
 	printk("Bluetooth initialized\n");
 
+	if (IS_ENABLED(CONFIG_BT_SETTINGS)) {
+		/* Identity and bonds, before anything looks at them */
+		err = settings_load_subtree("bt");
+		if (err) {
+			printk("Bluetooth settings load failed (err %d)\n", err);
+		}
+	}
+
+#if defined(CONFIG_CENTRAL_SECURITY)
+	bt_conn_auth_info_cb_register(&auth_info_cb);
+#endif
+
+	for (size_t i = 0; i < ARRAY_SIZE(peers); i++) {
+		k_work_init_delayable(&peers[i].disconnect_work, disconnect_work_handler);
+#if defined(CONFIG_CENTRAL_EATT)
+		k_work_init_delayable(&peers[i].eatt_work, eatt_work_handler);
+#endif
+	}
+
+	if (IS_ENABLED(CONFIG_CENTRAL_GATT_CACHE)) {
+		err = gatt_cache_init();
+		if (err) {
+			printk("GATT cache init failed (err %d)\n", err);
+		}
+	}
+
+	if (IS_ENABLED(CONFIG_CENTRAL_FAST_CONNECT)) {
+		fast_connect_init(start_scan);
+	}
+
 	start_scan();
 	return 0;
 }
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#if defined(CONFIG_ARCH_POSIX)
+#include "posix_native_task.h"
+#endif
+
+#include "ntf_stats.h"
+
+/* Bucket n counts latencies in [2^(n-1), 2^n) us, bucket 0 is < 1 us */
+#define BUCKETS 24
+
+struct ntf_stats {
+	uint32_t hist[BUCKETS];
+	uint64_t received;
+	uint64_t stamped;
+	uint64_t lost;
+	uint64_t bytes;
+	int64_t latency_min_us;
+	int64_t latency_max_us;
+	int64_t latency_sum_us;
+	int64_t first_rx_ms;
+	int64_t last_rx_ms;
+};
+
+static struct ntf_stats stats;
+static struct k_spinlock lock;
+
+void ntf_stats_record(uint16_t len, int64_t latency_us, uint32_t lost)
+{
+	int64_t now_ms = k_uptime_get();
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	if (!stats.received) {
+		stats.first_rx_ms = now_ms;
+	}
+	stats.last_rx_ms = now_ms;
+
+	stats.received++;
+	stats.bytes += len;
+	stats.lost += lost;
+
+	if (latency_us >= 0) {
+		if (!stats.stamped) {
+			stats.latency_min_us = latency_us;
+			stats.latency_max_us = latency_us;
+		}
+
+		stats.stamped++;
+		stats.latency_sum_us += latency_us;
+		stats.latency_min_us = MIN(stats.latency_min_us, latency_us);
+		stats.latency_max_us = MAX(stats.latency_max_us, latency_us);
+		stats.hist[MIN(find_msb_set((uint32_t)MIN(latency_us, UINT32_MAX)),
+			       BUCKETS - 1)]++;
+	}
+
+	k_spin_unlock(&lock, key);
+}
+
+void ntf_stats_print(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct ntf_stats s = stats;
+	int64_t span_ms;
+	uint64_t bps;
+	int64_t avg;
+
+	k_spin_unlock(&lock, key);
+
+	span_ms = s.last_rx_ms - s.first_rx_ms;
+	bps = span_ms > 0 ? s.bytes * 8U * MSEC_PER_SEC / span_ms : 0;
+
+	printk("[NTF STATS] %llu received, %llu lost, %llu bytes, %llu bps\n",
+	       s.received, s.lost, s.bytes, bps);
+
+	if (!s.stamped) {
+		return;
+	}
+
+	avg = s.latency_sum_us / (int64_t)s.stamped;
+
+	printk("[NTF STATS] latency (us) min/avg/max %lld/%lld/%lld\n",
+	       s.latency_min_us, avg, s.latency_max_us);
+
+	for (size_t i = 0; i < BUCKETS; i++) {
+		if (s.hist[i]) {
+			printk("[NTF STATS] < %8lu us: %u\n", BIT(i), s.hist[i]);
+		}
+	}
+
+	printk("METRICS {\"ntf\": {\"received\": %llu, \"lost\": %llu, \"bytes\": %llu, "
+	       "\"bps\": %llu, \"latency_us\": {\"min\": %lld, \"avg\": %lld, \"max\": %lld}}}\n",
+	       s.received, s.lost, s.bytes, bps, s.latency_min_us, avg, s.latency_max_us);
+}
+
+#if CONFIG_CENTRAL_NTF_STATS_PERIOD_S > 0
+static void print_work_handler(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+
+	ntf_stats_print();
+	k_work_schedule(dwork, K_SECONDS(CONFIG_CENTRAL_NTF_STATS_PERIOD_S));
+}
+
+static K_WORK_DELAYABLE_DEFINE(print_work, print_work_handler);
+
+static int ntf_stats_init(void)
+{
+	k_work_schedule(&print_work, K_SECONDS(CONFIG_CENTRAL_NTF_STATS_PERIOD_S));
+
+	return 0;
+}
+
+SYS_INIT(ntf_stats_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+#endif /* CONFIG_CENTRAL_NTF_STATS_PERIOD_S > 0 */
+
+#if defined(CONFIG_ARCH_POSIX)
+NATIVE_TASK(ntf_stats_print, ON_EXIT, 11);
+#endif
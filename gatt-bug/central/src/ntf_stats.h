@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NTF_STATS_H_
+#define NTF_STATS_H_
+
+#include <stdint.h>
+
+/* Account one received notification.
+ *
+ * `latency_us` is negative if the notification wasn't stamped. `lost` is the
+ * number of notifications missing since the previous one from the same peer.
+ * Safe against concurrent ntf_stats_print().
+ */
+void ntf_stats_record(uint16_t len, int64_t latency_us, uint32_t lost);
+
+/* Print the latency histogram, throughput and loss counters */
+void ntf_stats_print(void);
+
+#endif /* NTF_STATS_H_ */
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NTF_STAMP_H_
+#define NTF_STAMP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/sys/byteorder.h>
+
+/* Trailer the peripheral appends to instrumented notifications:
+ *
+ *   magic (le16) | sequence number (le32) | sim_time_us() at TX (le64)
+ *
+ * The sequence number counts every notification the application tried to
+ * send, so gaps seen by the central are notifications that were dropped.
+ */
+#define NTF_STAMP_MAGIC 0x5354U
+#define NTF_STAMP_LEN   (2U + 4U + 8U)
+
+static inline void ntf_stamp_encode(uint8_t *buf, uint32_t seq, int64_t tx_us)
+{
+	sys_put_le16(NTF_STAMP_MAGIC, &buf[0]);
+	sys_put_le32(seq, &buf[2]);
+	sys_put_le64((uint64_t)tx_us, &buf[6]);
+}
+
+/* Decode the trailer at the end of a notification */
+static inline bool ntf_stamp_decode(const uint8_t *data, uint16_t len,
+				    uint32_t *seq, int64_t *tx_us)
+{
+	const uint8_t *p;
+
+	if (len < NTF_STAMP_LEN) {
+		return false;
+	}
+
+	p = &data[len - NTF_STAMP_LEN];
+	if (sys_get_le16(&p[0]) != NTF_STAMP_MAGIC) {
+		return false;
+	}
+
+	*seq = sys_get_le32(&p[2]);
+	*tx_us = (int64_t)sys_get_le64(&p[6]);
+
+	return true;
+}
+
+#endif /* NTF_STAMP_H_ */
@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SIM_TIME_H_
+#define SIM_TIME_H_
+
+#include <zephyr/kernel.h>
+
+/* Microseconds since boot.
+ *
+ * All the devices of a simulation boot at the same simulated instant, so this
+ * is also a simulation-wide timestamp that can be compared between devices.
+ * The resolution is one RTC tick (~30.5 us).
+ */
+static inline int64_t sim_time_us(void)
+{
+	return (int64_t)k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+#endif /* SIM_TIME_H_ */
@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TRAFFIC_GEN_UUID_H_
+#define TRAFFIC_GEN_UUID_H_
+
+#include <zephyr/bluetooth/uuid.h>
+
+/* Traffic generator service, see peripheral/src/traffic_gen.c */
+#define TRAFFIC_GEN_UUID_VAL \
+	BT_UUID_128_ENCODE(0x5d8e0001, 0x6a43, 0x4f3c, 0x9b1e, 0x2a7c4d0f6b10)
+
+/* Notify-only characteristic carrying the generated data */
+#define TRAFFIC_GEN_DATA_UUID_VAL \
+	BT_UUID_128_ENCODE(0x5d8e0002, 0x6a43, 0x4f3c, 0x9b1e, 0x2a7c4d0f6b10)
+
+#define TRAFFIC_GEN_UUID      BT_UUID_DECLARE_128(TRAFFIC_GEN_UUID_VAL)
+#define TRAFFIC_GEN_DATA_UUID BT_UUID_DECLARE_128(TRAFFIC_GEN_DATA_UUID_VAL)
+
+#endif /* TRAFFIC_GEN_UUID_H_ */
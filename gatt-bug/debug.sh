@@ -6,6 +6,10 @@ set -eu
 central="$(west topdir)/bsim-demo/gatt-bug/central/build/zephyr/zephyr.exe"
 peripheral="$(west topdir)/bsim-demo/gatt-bug/peripheral/build/zephyr/zephyr.exe"
 
+# Simulated flash contents (GATT cache, bonds) survive between runs
+flash_dir="$(west topdir)/bsim-demo/gatt-bug/flash"
+mkdir -p ${flash_dir}
+
 echo "Start PHY"
 # Start the PHY
 pushd "${BSIM_OUT_PATH}/bin"
@@ -18,10 +22,10 @@ pushd "${BSIM_COMPONENTS_PATH}/device_handbrake"
 
 echo "Start peripheral"
 # Start the two devices
-$peripheral -s=my-sim-id -d=1 &
+$peripheral -s=my-sim-id -d=1 -flash=${flash_dir}/peripheral-1.bin &
 
 echo "Start debug server on central device"
-gdbserver :2345 $central -s=my-sim-id -d=0 &
+gdbserver :2345 $central -s=my-sim-id -d=0 -flash=${flash_dir}/central.bin &
 
 # Give some time for server to start up
 sleep 0.5
@@ -17,6 +17,14 @@
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/bluetooth/services/bas.h>
 #include <zephyr/bluetooth/services/hrs.h>
+#include <zephyr/settings/settings.h>
+
+#include "multi_central.h"
+#include "ntf_stamp.h"
+#include "sim_time.h"
+
+#define HRS_PERIOD K_SECONDS(1)
+#define BAS_PERIOD K_SECONDS(1)
 
 static bool hrf_ntf_enabled;
 
@@ -26,22 +34,50 @@ static const struct bt_data ad[] = {
 		      BT_UUID_16_ENCODE(BT_UUID_HRS_VAL),
 		      BT_UUID_16_ENCODE(BT_UUID_BAS_VAL),
 		      BT_UUID_16_ENCODE(BT_UUID_DIS_VAL)),
-#if defined(CONFIG_BT_EXT_ADV)
+#if defined(CONFIG_BT_EXT_ADV) && !defined(CONFIG_PERIPHERAL_MULTI_CENTRAL)
 	BT_DATA(BT_DATA_NAME_COMPLETE, CONFIG_BT_DEVICE_NAME, sizeof(CONFIG_BT_DEVICE_NAME) - 1),
-#endif /* CONFIG_BT_EXT_ADV */
+#endif /* CONFIG_BT_EXT_ADV && !CONFIG_PERIPHERAL_MULTI_CENTRAL */
 };
 
-#if !defined(CONFIG_BT_EXT_ADV)
+/* The multi-central advertising sets use legacy PDUs, with a scan response */
+#if !defined(CONFIG_BT_EXT_ADV) || defined(CONFIG_PERIPHERAL_MULTI_CENTRAL)
 static const struct bt_data sd[] = {
 	BT_DATA(BT_DATA_NAME_COMPLETE, CONFIG_BT_DEVICE_NAME, sizeof(CONFIG_BT_DEVICE_NAME) - 1),
 };
-#endif /* !CONFIG_BT_EXT_ADV */
+#endif /* !CONFIG_BT_EXT_ADV || CONFIG_PERIPHERAL_MULTI_CENTRAL */
+
+/* Everything below runs from the system workqueue, driven by the Bluetooth
+ * callbacks and by timers, instead of being polled from main().
+ */
+static void adv_work_handler(struct k_work *work);
+static void hrs_work_handler(struct k_work *work);
+static void bas_work_handler(struct k_work *work);
+
+static K_WORK_DEFINE(adv_work, adv_work_handler);
+static K_WORK_DELAYABLE_DEFINE(hrs_work, hrs_work_handler);
+static K_WORK_DELAYABLE_DEFINE(bas_work, bas_work_handler);
 
-/* Use atomic variable, 2 bits for connection and disconnection state */
-static ATOMIC_DEFINE(state, 2U);
+static void adv_work_handler(struct k_work *work)
+{
+	int err;
 
-#define STATE_CONNECTED    1U
-#define STATE_DISCONNECTED 2U
+	if (IS_ENABLED(CONFIG_PERIPHERAL_MULTI_CENTRAL)) {
+		/* Keeps advertising while connected, until all connections
+		 * are in use
+		 */
+		multi_central_adv_start(ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+		return;
+	}
+
+	printk("Starting Legacy Advertising (connectable and scannable)\n");
+	err = bt_le_adv_start(BT_LE_ADV_CONN_ONE_TIME, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+	if (err) {
+		printk("Advertising failed to start (err %d)\n", err);
+		return;
+	}
+
+	printk("Advertising successfully started\n");
+}
 
 static void connected(struct bt_conn *conn, uint8_t err)
 {
@@ -49,21 +85,27 @@ static void connected(struct bt_conn *conn, uint8_t err)
 		printk("Connection failed, err 0x%02x %s\n", err, bt_hci_err_to_str(err));
 	} else {
 		printk("Connected\n");
-
-		(void)atomic_set_bit(state, STATE_CONNECTED);
 	}
 }
 
 static void disconnected(struct bt_conn *conn, uint8_t reason)
 {
 	printk("Disconnected, reason 0x%02x %s\n", reason, bt_hci_err_to_str(reason));
+}
 
-	(void)atomic_set_bit(state, STATE_DISCONNECTED);
+static void recycled(void)
+{
+	/* The connection object is back in the pool, after a disconnection or
+	 * a failed connection, so advertising can be restarted right away
+	 * without running out of connections.
+	 */
+	k_work_submit(&adv_work);
 }
 
 BT_CONN_CB_DEFINE(conn_callbacks) = {
 	.connected = connected,
 	.disconnected = disconnected,
+	.recycled = recycled,
 };
 
 static void hrs_ntf_changed(bool enabled)
@@ -72,6 +114,12 @@ static void hrs_ntf_changed(bool enabled)
 
 	printk("HRS notification status changed: %s\n",
 	       enabled ? "enabled" : "disabled");
+
+	if (enabled) {
+		k_work_reschedule(&hrs_work, K_NO_WAIT);
+	} else {
+		k_work_cancel_delayable(&hrs_work);
+	}
 }
 
 static struct bt_hrs_cb hrs_cb = {
@@ -104,6 +152,61 @@ static void bas_notify(void)
 	bt_bas_set_battery_level(battery_level);
 }
 
+static void bas_work_handler(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+
+	/* Battery level simulation */
+	bas_notify();
+
+	k_work_schedule(dwork, BAS_PERIOD);
+}
+
+static void hrs_notify_stamped(uint8_t heartrate)
+{
+	static const struct bt_gatt_attr *attr;
+	static uint32_t seq;
+	uint8_t hrm[2 + NTF_STAMP_LEN];
+	int err;
+
+	if (!attr) {
+		attr = bt_gatt_find_by_uuid(NULL, 0, BT_UUID_HRS_MEASUREMENT);
+	}
+
+	/* Same encoding as bt_hrs_notify(): uint8 value, sensor contact */
+	hrm[0] = 0x06;
+	hrm[1] = heartrate;
+	ntf_stamp_encode(&hrm[2], seq++, sim_time_us());
+
+	err = bt_gatt_notify(NULL, attr, hrm, sizeof(hrm));
+	if (err && err != -ENOTCONN) {
+		printk("Notification failed (err %d)\n", err);
+	}
+}
+
+/* One measurement for all the subscribed centrals */
+static void hrs_notify_fan_out(uint8_t heartrate)
+{
+	static const struct bt_gatt_attr *attr;
+	static uint32_t seq;
+	uint8_t hrm[2 + NTF_STAMP_LEN];
+	uint16_t len = 2U;
+
+	if (!attr) {
+		attr = bt_gatt_find_by_uuid(NULL, 0, BT_UUID_HRS_MEASUREMENT);
+	}
+
+	hrm[0] = 0x06;
+	hrm[1] = heartrate;
+
+	if (IS_ENABLED(CONFIG_PERIPHERAL_NTF_STAMP)) {
+		ntf_stamp_encode(&hrm[2], seq++, sim_time_us());
+		len += NTF_STAMP_LEN;
+	}
+
+	multi_central_notify(attr, hrm, len);
+}
+
 static void hrs_notify(void)
 {
 	static uint8_t heartrate = 90U;
@@ -114,11 +217,30 @@ static void hrs_notify(void)
 		heartrate = 90U;
 	}
 
-	if (hrf_ntf_enabled) {
+	if (!hrf_ntf_enabled) {
+		return;
+	}
+
+	if (IS_ENABLED(CONFIG_PERIPHERAL_MULTI_CENTRAL)) {
+		hrs_notify_fan_out(heartrate);
+	} else if (IS_ENABLED(CONFIG_PERIPHERAL_NTF_STAMP)) {
+		hrs_notify_stamped(heartrate);
+	} else {
 		bt_hrs_notify(heartrate);
 	}
 }
 
+static void hrs_work_handler(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+
+	hrs_notify();
+
+	if (hrf_ntf_enabled) {
+		k_work_schedule(dwork, HRS_PERIOD);
+	}
+}
+
 int main(void)
 {
 	int err;
@@ -131,42 +253,20 @@ int main(void)
 
 	printk("Bluetooth initialized\n");
 
-	bt_conn_auth_cb_register(&auth_cb_display);
-
-	bt_hrs_cb_register(&hrs_cb);
-
-	printk("Starting Legacy Advertising (connectable and scannable)\n");
-	err = bt_le_adv_start(BT_LE_ADV_CONN_ONE_TIME, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
-	if (err) {
-		printk("Advertising failed to start (err %d)\n", err);
-		return 0;
+	if (IS_ENABLED(CONFIG_BT_SETTINGS)) {
+		/* Identity and bonds */
+		err = settings_load();
+		if (err) {
+			printk("Settings load failed (err %d)\n", err);
+		}
 	}
 
-	printk("Advertising successfully started\n");
-
-	/* Implement notification. */
-	while (1) {
-		k_sleep(K_SECONDS(1));
-
-		/* Heartrate measurements simulation */
-		hrs_notify();
-
-		/* Battery level simulation */
-		bas_notify();
+	bt_conn_auth_cb_register(&auth_cb_display);
 
-		if (atomic_test_and_clear_bit(state, STATE_CONNECTED)) {
-			/* Connected callback executed */
+	bt_hrs_cb_register(&hrs_cb);
 
-		} else if (atomic_test_and_clear_bit(state, STATE_DISCONNECTED)) {
-			printk("Starting Legacy Advertising (connectable and scannable)\n");
-			err = bt_le_adv_start(BT_LE_ADV_CONN_ONE_TIME, ad, ARRAY_SIZE(ad), sd,
-					      ARRAY_SIZE(sd));
-			if (err) {
-				printk("Advertising failed to start (err %d)\n", err);
-				return 0;
-			}
-		}
-	}
+	k_work_submit(&adv_work);
+	k_work_schedule(&bas_work, BAS_PERIOD);
 
 	return 0;
 }
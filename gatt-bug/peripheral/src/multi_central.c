@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#if defined(CONFIG_ARCH_POSIX)
+#include "posix_native_task.h"
+#endif
+
+#include "multi_central.h"
+#include "sim_time.h"
+
+#define ADV_SETS  CONFIG_PERIPHERAL_MULTI_CENTRAL_ADV_SETS
+#define QUEUE_MAX CONFIG_PERIPHERAL_MULTI_CENTRAL_QUEUE
+
+struct central_stats {
+	uint32_t connections;
+	/* Handed to the host, completed, skipped because the queue was full */
+	uint32_t sent;
+	uint32_t completed;
+	uint32_t skipped;
+	/* Notifications pending in the host, sampled on every send */
+	uint64_t depth_sum;
+	uint32_t depth_max;
+	/* Handed to the host -> sent to the controller */
+	int64_t latency_sum_us;
+	int64_t latency_max_us;
+};
+
+/* Indexed by bt_conn_index() */
+struct central {
+	struct bt_conn *conn;
+	atomic_t queued;
+	struct central_stats stats;
+};
+
+static struct central centrals[CONFIG_BT_MAX_CONN];
+static struct k_spinlock lock;
+static uint32_t connected_now;
+static uint32_t connected_max;
+
+static struct bt_le_ext_adv *adv_sets[ADV_SETS];
+static bool adv_running[ADV_SETS];
+static const struct bt_data *adv_ad;
+static const struct bt_data *adv_sd;
+static size_t adv_ad_len;
+static size_t adv_sd_len;
+
+static void adv_restart_work_handler(struct k_work *work)
+{
+	multi_central_adv_start(adv_ad, adv_ad_len, adv_sd, adv_sd_len);
+}
+
+static K_WORK_DEFINE(adv_restart_work, adv_restart_work_handler);
+
+static void adv_connected(struct bt_le_ext_adv *adv, struct bt_le_ext_adv_connected_info *info)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(adv_sets); i++) {
+		if (adv_sets[i] == adv) {
+			adv_running[i] = false;
+		}
+	}
+
+	/* The set stopped with the connection, restart it for the next one */
+	k_work_submit(&adv_restart_work);
+}
+
+static const struct bt_le_ext_adv_cb adv_cb = {
+	.connected = adv_connected,
+};
+
+static void count_conn(struct bt_conn *conn, void *data)
+{
+	(*(size_t *)data)++;
+}
+
+static int adv_create(size_t i)
+{
+	/* Legacy PDUs, so centrals scanning without extended advertising
+	 * support see all the sets.
+	 */
+	const struct bt_le_adv_param param = BT_LE_ADV_PARAM_INIT(BT_LE_ADV_OPT_CONNECTABLE,
+								  BT_GAP_ADV_FAST_INT_MIN_2,
+								  BT_GAP_ADV_FAST_INT_MAX_2, NULL);
+	int err;
+
+	err = bt_le_ext_adv_create(&param, &adv_cb, &adv_sets[i]);
+	if (err) {
+		return err;
+	}
+
+	return bt_le_ext_adv_set_data(adv_sets[i], adv_ad, adv_ad_len, adv_sd, adv_sd_len);
+}
+
+void multi_central_adv_start(const struct bt_data *ad, size_t ad_len,
+			     const struct bt_data *sd, size_t sd_len)
+{
+	size_t used = 0;
+	int err;
+
+	adv_ad = ad;
+	adv_ad_len = ad_len;
+	adv_sd = sd;
+	adv_sd_len = sd_len;
+
+	/* Connections and connectable advertising sets both hold a connection
+	 * object
+	 */
+	bt_conn_foreach(BT_CONN_TYPE_LE, count_conn, &used);
+
+	for (size_t i = 0; i < ARRAY_SIZE(adv_sets) && used < CONFIG_BT_MAX_CONN; i++) {
+		if (adv_running[i]) {
+			continue;
+		}
+
+		if (!adv_sets[i]) {
+			err = adv_create(i);
+			if (err) {
+				printk("Advertising set %zu failed to be created (err %d)\n", i, err);
+				continue;
+			}
+		}
+
+		err = bt_le_ext_adv_start(adv_sets[i], BT_LE_EXT_ADV_START_DEFAULT);
+		if (err && err != -EALREADY) {
+			printk("Advertising set %zu failed to start (err %d)\n", i, err);
+			continue;
+		}
+
+		adv_running[i] = true;
+		used++;
+	}
+}
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+	struct central *c = &centrals[bt_conn_index(conn)];
+	k_spinlock_key_t key;
+
+	if (err) {
+		return;
+	}
+
+	key = k_spin_lock(&lock);
+
+	c->conn = bt_conn_ref(conn);
+	c->stats.connections++;
+	connected_now++;
+	connected_max = MAX(connected_max, connected_now);
+
+	k_spin_unlock(&lock, key);
+
+	printk("[MULTI] central %u connected, %u connected\n", bt_conn_index(conn), connected_now);
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	struct central *c = &centrals[bt_conn_index(conn)];
+	k_spinlock_key_t key;
+
+	if (c->conn != conn) {
+		return;
+	}
+
+	key = k_spin_lock(&lock);
+
+	c->conn = NULL;
+	connected_now--;
+	/* The host drops the pending notifications without calling us back */
+	atomic_clear(&c->queued);
+
+	k_spin_unlock(&lock, key);
+
+	bt_conn_unref(conn);
+}
+
+BT_CONN_CB_DEFINE(multi_central_conn_callbacks) = {
+	.connected = connected,
+	.disconnected = disconnected,
+};
+
+static void sent_cb(struct bt_conn *conn, void *user_data)
+{
+	struct central *c = &centrals[bt_conn_index(conn)];
+	/* Wraps every ~71 minutes, the difference doesn't */
+	int64_t latency = (uint32_t)sim_time_us() - POINTER_TO_UINT(user_data);
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	atomic_dec(&c->queued);
+	c->stats.completed++;
+	c->stats.latency_sum_us += latency;
+	c->stats.latency_max_us = MAX(c->stats.latency_max_us, latency);
+
+	k_spin_unlock(&lock, key);
+}
+
+void multi_central_notify(const struct bt_gatt_attr *attr, const void *data, uint16_t len)
+{
+	/* The data is copied for every connection, only the time is shared */
+	struct bt_gatt_notify_params params = {
+		.attr = attr,
+		.data = data,
+		.len = len,
+		.func = sent_cb,
+		.user_data = UINT_TO_POINTER((uint32_t)sim_time_us()),
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(centrals); i++) {
+		struct central *c = &centrals[i];
+		k_spinlock_key_t key;
+		atomic_val_t depth;
+		int err;
+
+		if (!c->conn || !bt_gatt_is_subscribed(c->conn, attr, BT_GATT_CCC_NOTIFY)) {
+			continue;
+		}
+
+		depth = atomic_inc(&c->queued);
+		if (depth >= QUEUE_MAX) {
+			atomic_dec(&c->queued);
+
+			key = k_spin_lock(&lock);
+			c->stats.skipped++;
+			k_spin_unlock(&lock, key);
+			continue;
+		}
+
+		err = bt_gatt_notify_cb(c->conn, &params);
+		if (err) {
+			atomic_dec(&c->queued);
+			if (err != -ENOTCONN) {
+				printk("[MULTI] central %zu notification failed (err %d)\n", i, err);
+			}
+			continue;
+		}
+
+		key = k_spin_lock(&lock);
+		c->stats.sent++;
+		c->stats.depth_sum += depth + 1;
+		c->stats.depth_max = MAX(c->stats.depth_max, depth + 1);
+		k_spin_unlock(&lock, key);
+	}
+}
+
+void multi_central_print(void)
+{
+	struct central_stats s;
+	bool first = true;
+
+	printk("[MULTI] %u centrals connected at most\n", connected_max);
+
+	for (size_t i = 0; i < ARRAY_SIZE(centrals); i++) {
+		s = centrals[i].stats;
+		if (!s.connections) {
+			continue;
+		}
+
+		printk("[MULTI] conn %zu: %u connections, %u sent, %u skipped, "
+		       "queue depth avg %llu.%02llu max %u, TX latency avg %lld max %lld us\n",
+		       i, s.connections, s.sent, s.skipped,
+		       s.sent ? s.depth_sum / s.sent : 0, s.sent ? s.depth_sum * 100 / s.sent % 100 : 0,
+		       s.depth_max, s.completed ? s.latency_sum_us / s.completed : 0,
+		       s.latency_max_us);
+	}
+
+	printk("METRICS {\"multi_central\": {\"connected_max\": %u, \"conns\": [", connected_max);
+	for (size_t i = 0; i < ARRAY_SIZE(centrals); i++) {
+		s = centrals[i].stats;
+		if (!s.connections) {
+			continue;
+		}
+
+		printk("%s{\"conn\": %zu, \"connections\": %u, \"sent\": %u, \"completed\": %u, "
+		       "\"skipped\": %u, \"queue_avg\": %llu.%02llu, \"queue_max\": %u, "
+		       "\"tx_latency_avg_us\": %lld, \"tx_latency_max_us\": %lld}",
+		       first ? "" : ", ", i, s.connections, s.sent, s.completed, s.skipped,
+		       s.sent ? s.depth_sum / s.sent : 0, s.sent ? s.depth_sum * 100 / s.sent % 100 : 0,
+		       s.depth_max, s.completed ? s.latency_sum_us / s.completed : 0,
+		       s.latency_max_us);
+		first = false;
+	}
+	printk("]}}\n");
+}
+
+#if defined(CONFIG_ARCH_POSIX)
+NATIVE_TASK(multi_central_print, ON_EXIT, 10);
+#endif
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MULTI_CENTRAL_H_
+#define MULTI_CENTRAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/gatt.h>
+
+/* Start every advertising set that isn't advertising, as long as there are
+ * free connections. The data is kept and reused when a set restarts after a
+ * central connected through it.
+ */
+void multi_central_adv_start(const struct bt_data *ad, size_t ad_len,
+			     const struct bt_data *sd, size_t sd_len);
+
+/* Notify `attr` to every central subscribed to it. A central that already has
+ * CONFIG_PERIPHERAL_MULTI_CENTRAL_QUEUE notifications pending in the host is
+ * skipped, so a slow one doesn't hold back the others.
+ */
+void multi_central_notify(const struct bt_gatt_attr *attr, const void *data, uint16_t len);
+
+/* Print the per-connection queue depth and TX completion latency, and a
+ * METRICS line
+ */
+void multi_central_print(void);
+
+#endif /* MULTI_CENTRAL_H_ */
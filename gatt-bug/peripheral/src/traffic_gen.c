@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#if defined(CONFIG_ARCH_POSIX)
+#include "posix_native_task.h"
+#endif
+
+#include "ntf_stamp.h"
+#include "sim_time.h"
+#include "traffic_gen.h"
+#include "traffic_gen_uuid.h"
+
+/* Opcode and handle of the ATT Handle Value Notification */
+#define ATT_NTF_HDR_LEN 3U
+#define LEN_MAX         (CONFIG_BT_L2CAP_TX_MTU - ATT_NTF_HDR_LEN)
+#define INTERVAL_MS     CONFIG_PERIPHERAL_TRAFFIC_GEN_INTERVAL_MS
+#define IN_FLIGHT_MAX   CONFIG_PERIPHERAL_TRAFFIC_GEN_IN_FLIGHT
+
+/* Retry delay when the host is out of TX buffers and nothing is in flight */
+#define RETRY_MS 1
+
+static void gen_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(gen_work, gen_work_handler);
+
+static struct bt_conn *gen_conn;
+static bool gen_enabled;
+static uint32_t seq;
+
+static atomic_t in_flight;
+static atomic_t sent;
+static atomic_t sent_bytes;
+/* Interval mode only: ticks where the TX pipeline was still full */
+static atomic_t skipped;
+
+static uint8_t payload[LEN_MAX];
+
+static void ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+	gen_enabled = (value == BT_GATT_CCC_NOTIFY);
+
+	printk("Traffic generator %s\n", gen_enabled ? "started" : "stopped");
+
+	if (gen_enabled) {
+		k_work_reschedule(&gen_work, K_NO_WAIT);
+	}
+}
+
+BT_GATT_SERVICE_DEFINE(traffic_gen_svc,
+	BT_GATT_PRIMARY_SERVICE(TRAFFIC_GEN_UUID),
+	BT_GATT_CHARACTERISTIC(TRAFFIC_GEN_DATA_UUID, BT_GATT_CHRC_NOTIFY,
+			       BT_GATT_PERM_NONE, NULL, NULL, NULL),
+	BT_GATT_CCC(ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+);
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+	if (!err && !gen_conn) {
+		gen_conn = bt_conn_ref(conn);
+	}
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	if (conn != gen_conn) {
+		return;
+	}
+
+	bt_conn_unref(gen_conn);
+	gen_conn = NULL;
+	gen_enabled = false;
+	/* The host drops the pending notifications without calling us back */
+	atomic_clear(&in_flight);
+}
+
+BT_CONN_CB_DEFINE(traffic_gen_conn_callbacks) = {
+	.connected = connected,
+	.disconnected = disconnected,
+};
+
+static uint16_t payload_len(struct bt_conn *conn)
+{
+	uint16_t len = MIN(bt_gatt_get_mtu(conn) - ATT_NTF_HDR_LEN, LEN_MAX);
+
+	if (CONFIG_PERIPHERAL_TRAFFIC_GEN_LEN > 0) {
+		len = MIN(len, CONFIG_PERIPHERAL_TRAFFIC_GEN_LEN);
+	}
+
+	return len;
+}
+
+static void sent_cb(struct bt_conn *conn, void *user_data)
+{
+	uint16_t len = POINTER_TO_UINT(user_data);
+
+	atomic_dec(&in_flight);
+	atomic_inc(&sent);
+	atomic_add(&sent_bytes, len);
+
+	/* Back-to-back: refill the pipeline as soon as a slot frees up */
+	if (INTERVAL_MS == 0) {
+		k_work_reschedule(&gen_work, K_NO_WAIT);
+	}
+}
+
+static int send_one(struct bt_conn *conn, uint16_t len)
+{
+	struct bt_gatt_notify_params params = {
+		.attr = &traffic_gen_svc.attrs[1],
+		.data = payload,
+		.len = len,
+		.func = sent_cb,
+		.user_data = UINT_TO_POINTER(len),
+	};
+	int err;
+
+	if (len >= NTF_STAMP_LEN) {
+		ntf_stamp_encode(&payload[len - NTF_STAMP_LEN], seq, sim_time_us());
+	}
+
+	atomic_inc(&in_flight);
+
+	err = bt_gatt_notify_cb(conn, &params);
+	if (err) {
+		atomic_dec(&in_flight);
+	}
+
+	return err;
+}
+
+static void gen_work_handler(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	uint16_t len;
+	int err = 0;
+
+	if (!gen_enabled || !gen_conn) {
+		return;
+	}
+
+	len = payload_len(gen_conn);
+
+	if (INTERVAL_MS > 0) {
+		/* Fixed rate: one notification per tick. A tick finding the
+		 * pipeline full still consumes a sequence number, so the
+		 * central sees it as lost.
+		 */
+		if (atomic_get(&in_flight) < IN_FLIGHT_MAX) {
+			err = send_one(gen_conn, len);
+		} else {
+			atomic_inc(&skipped);
+		}
+
+		seq++;
+		k_work_schedule(dwork, K_MSEC(INTERVAL_MS));
+	} else {
+		while (atomic_get(&in_flight) < IN_FLIGHT_MAX) {
+			err = send_one(gen_conn, len);
+			if (err) {
+				break;
+			}
+
+			seq++;
+		}
+
+		/* Normally sent_cb() restarts us, unless nothing is pending */
+		if (err == -ENOMEM && !atomic_get(&in_flight)) {
+			k_work_schedule(dwork, K_MSEC(RETRY_MS));
+		}
+	}
+
+	if (err && err != -ENOMEM && err != -ENOTCONN) {
+		printk("Traffic generator notification failed (err %d)\n", err);
+	}
+}
+
+void traffic_gen_print(void)
+{
+	printk("[TRAFFIC GEN] %ld notifications, %ld bytes, %ld skipped\n",
+	       atomic_get(&sent), atomic_get(&sent_bytes), atomic_get(&skipped));
+	printk("METRICS {\"traffic_gen\": {\"sent\": %ld, \"bytes\": %ld, \"skipped\": %ld}}\n",
+	       atomic_get(&sent), atomic_get(&sent_bytes), atomic_get(&skipped));
+}
+
+static int traffic_gen_init(void)
+{
+	for (size_t i = 0; i < sizeof(payload); i++) {
+		payload[i] = (uint8_t)i;
+	}
+
+	return 0;
+}
+
+SYS_INIT(traffic_gen_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#if defined(CONFIG_ARCH_POSIX)
+NATIVE_TASK(traffic_gen_print, ON_EXIT, 10);
+#endif
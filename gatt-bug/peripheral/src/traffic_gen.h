@@ -0,0 +1,13 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TRAFFIC_GEN_H_
+#define TRAFFIC_GEN_H_
+
+/* Print the number of notifications and bytes sent so far */
+void traffic_gen_print(void);
+
+#endif /* TRAFFIC_GEN_H_ */
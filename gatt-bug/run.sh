@@ -2,6 +2,11 @@
 
 set -eu
 
+# Number of peripherals the central connects to
+num_peripherals=${NUM_PERIPHERALS:-1}
+# Number of centrals, more than one needs a peripheral built with overlay-multi.conf
+num_centrals=${NUM_CENTRALS:-1}
+
 pushd $(west topdir)/bsim-demo/gatt-bug/central
 central="$(pwd)/build/zephyr/zephyr.exe"
 popd
@@ -10,17 +15,29 @@ pushd $(west topdir)/bsim-demo/gatt-bug/peripheral
 peripheral="$(pwd)/build/zephyr/zephyr.exe"
 popd
 
+# Simulated flash contents (GATT cache, bonds) survive between runs
+flash_dir=$(west topdir)/bsim-demo/gatt-bug/flash
+mkdir -p ${flash_dir}
+
+# centrals, peripherals and the handbrake
+num_devices=$((num_centrals + num_peripherals + 1))
+
 echo "Start PHY"
 # Start the PHY
 pushd "${BSIM_OUT_PATH}/bin"
-./bs_2G4_phy_v1 -s=my-sim-id -D=3 &
+./bs_2G4_phy_v1 -s=my-sim-id -D=${num_devices} &
 
 echo "Slow down sim"
 # Slow down the simulation: clamp speed to 10x real-time
 pushd "${BSIM_COMPONENTS_PATH}/device_handbrake"
-./bs_device_handbrake -s=my-sim-id -d=2 -r=10 &
+./bs_device_handbrake -s=my-sim-id -d=$((num_devices - 1)) -r=10 &
 
-echo "Start two devices"
-# Start the two devices
-$peripheral -s=my-sim-id -d=1 &
-$central -s=my-sim-id -d=0
+echo "Start ${num_peripherals} peripheral(s) and ${num_centrals} central(s)"
+# Each device gets its own seed, and so its own address
+for d in $(seq ${num_centrals} $((num_centrals + num_peripherals - 1))); do
+    $peripheral -s=my-sim-id -d=${d} -rs=${d} -flash=${flash_dir}/peripheral-${d}.bin &
+done
+for d in $(seq 1 $((num_centrals - 1))); do
+    $central -s=my-sim-id -d=${d} -rs=$((100 + d)) -flash=${flash_dir}/central-${d}.bin &
+done
+$central -s=my-sim-id -d=0 -flash=${flash_dir}/central.bin
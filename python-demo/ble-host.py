@@ -1,3 +1,4 @@
+import argparse
 import struct
 import binascii
 import os
@@ -5,6 +6,14 @@ import fcntl
 import sys
 import time
 
+import hci
+from hci import addr_bytes, le24
+
+ADV_ADDR = 'C1:23:45:67:89:0A'
+# Largest AD fragment in one LE Set Extended Advertising Data command
+EXT_AD_FRAGMENT_LEN = 251
+EXT_AD_LEN_MAX = 1650
+
 
 def generate_name(name: str) -> bytearray:
     ad_type = 0x09.to_bytes(1, "big")
@@ -15,6 +24,36 @@ def generate_name(name: str) -> bytearray:
 
     return ad
 
+def generate_ext_ad(length: int) -> bytes:
+    """The name, then manufacturer specific data elements up to `length`"""
+    ad = generate_name("🐍 is 🔥")
+    i = 0
+
+    while length - len(ad) >= 3:
+        elem = min(length - len(ad), 256)
+        ad += bytes([elem - 1, 0xFF]) + bytes((i + j) & 0xFF for j in range(elem - 2))
+        i += 1
+
+    return ad
+
+def ext_ad_commands(handle: int, ad: bytes):
+    """LE Set Extended Advertising Data commands carrying `ad`, in order"""
+    chunks = [ad[i:i + EXT_AD_FRAGMENT_LEN]
+              for i in range(0, len(ad), EXT_AD_FRAGMENT_LEN)] or [b'']
+
+    for i, chunk in enumerate(chunks):
+        if len(chunks) == 1:
+            operation = 0x03    # complete
+        elif i == 0:
+            operation = 0x01    # first fragment
+        elif i == len(chunks) - 1:
+            operation = 0x02    # last fragment
+        else:
+            operation = 0x00    # intermediate fragment
+
+        # Fragment preference 0x01: the controller should not fragment
+        yield 0x2037, bytes([handle, operation, 0x01, len(chunk)]) + chunk
+
 def hci_cmd(opcode, data):
     return struct.pack('<BHB',
                        0x01,
@@ -43,13 +82,68 @@ def advertise(tx, rx, duration_s=1):
     tx.write(bytes.fromhex('01 0A 20 01 00'))
 
 
+def advertise_ext(tx, rx, args):
+    h = hci.Hci(tx, rx)
+    handle = 0x00
+
+    h.cmd(0x0C03)
+    h.cmd(0x0C01, bytes.fromhex('FF FF FF FF FF FF FF FF'))
+    h.cmd(0x2001, bytes.fromhex('FF FF FF FF FF FF FF FF'))
+
+    # Non-connectable, non-scannable: the data goes in an AUX_CHAIN_IND chain
+    interval = le24(args.interval_ms * 8 // 5)
+    params = bytes([handle]) + struct.pack('<H', 0x0000) + interval + interval
+    params += bytes([0x07, 0x01, 0x00]) + bytes(6)
+    params += bytes([0x00, 0x7F, 0x01, 0x00, args.phy, 0x00, 0x00])
+    h.cmd(0x2036, params)
+    h.cmd(0x2035, bytes([handle]) + addr_bytes(ADV_ADDR))
+
+    # The whole chain is pushed without waiting for each fragment
+    ad = generate_ext_ad(args.len)
+    commands = list(ext_ad_commands(handle, ad))
+
+    start = time.monotonic()
+    h.cmds(commands, window=args.window)
+    push_s = time.monotonic() - start
+
+    print('AD data: %u bytes in %u fragments, pushed in %.1f ms (%.0f kB/s)' %
+          (len(ad), len(commands), push_s * 1e3, len(ad) / push_s / 1e3 if push_s else 0))
+
+    # Start, wait, and stop advertiser
+    h.cmd(0x2039, bytes([0x01, 0x01, handle, 0x00, 0x00, 0x00]))
+    time.sleep(args.duration)
+    h.cmd(0x2039, bytes([0x00, 0x01, handle, 0x00, 0x00, 0x00]))
+
+
 def main():
+    parser = argparse.ArgumentParser(description='Advertise from the python host')
+    parser.add_argument('--duration', type=float, default=1,
+                        help='seconds to advertise for (default: %(default)s)')
+    parser.add_argument('--ext', action='store_true',
+                        help='use extended advertising (default: legacy)')
+    parser.add_argument('--len', type=int, default=1000,
+                        help='extended AD data length, max %d (default: %%(default)s)'
+                             % EXT_AD_LEN_MAX)
+    parser.add_argument('--interval-ms', type=int, default=100,
+                        help='extended advertising interval (default: %(default)s)')
+    parser.add_argument('--phy', type=int, default=2, choices=(1, 2),
+                        help='secondary PHY, 1M or 2M (default: %(default)s)')
+    parser.add_argument('--window', type=int, default=8,
+                        help='AD fragments in flight, 0 to follow the controller '
+                             '(default: %(default)s)')
+    args = parser.parse_args()
+
+    args.len = min(args.len, EXT_AD_LEN_MAX)
+
     command_fifo = '/tmp/py/uart.h2c'
     response_fifo = '/tmp/py/uart.c2h'
 
     with open(command_fifo, 'wb', buffering=0) as tx:
         with open(response_fifo, 'rb', buffering=0) as rx:
-            advertise(tx, rx, 1)
+            if args.ext:
+                advertise_ext(tx, rx, args)
+            else:
+                advertise(tx, rx, args.duration)
 
 if __name__ == "__main__":
     main()
@@ -22,12 +22,22 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <zephyr/sys/printk.h>
+
+#include "sim_rtf.h"
+#include "sim_trace.h"
 
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(uart_pipe, LOG_LEVEL_INF);
 
 #define RETRY_DELAY K_MSEC(CONFIG_UART_POSIX_PIPE_RETRY_MS)
 
+#if defined(CONFIG_UART_POSIX_PIPE_TX_BATCH_SIZE) && (CONFIG_UART_POSIX_PIPE_TX_BATCH_SIZE > 0)
+#define NU_TX_BATCH 1
+#endif
+
 /*
  * UART driver for POSIX ARCH based boards.
  *
@@ -41,6 +51,26 @@ struct nu_async_ep {
     struct k_timer expiry;
 };
 
+#ifdef NU_TX_BATCH
+/* TX coalescing: uart_tx() buffers are copied back-to-back into `buf` and
+ * written to the pipe in one go, when the next one doesn't fit anymore or when
+ * the latency budget (started by the first byte) runs out.
+ */
+struct nu_batch {
+    uint8_t buf[CONFIG_UART_POSIX_PIPE_TX_BATCH_SIZE];
+    size_t len;     /* bytes in the batch */
+    size_t pos;     /* bytes already written to the pipe */
+    struct k_timer flush;
+    struct k_spinlock lock;
+};
+#endif /* NU_TX_BATCH */
+
+struct nu_stats {
+    uint32_t tx_packets;
+    uint32_t tx_writes;
+    uint64_t tx_bytes;
+};
+
 struct nu_isr_ep {
     bool enabled;
     /* FIXME: this is _really_ confusing. Use a proper state machine dammit. */
@@ -76,6 +106,10 @@ struct nu_state {
     struct k_timer timer;
     uart_callback_t cb;
     void *ud;
+    struct nu_stats stats;
+#ifdef NU_TX_BATCH
+    struct nu_batch batch;
+#endif
 #endif
 #ifdef CONFIG_UART_INTERRUPT_DRIVEN
     struct nu_isr isr;
@@ -142,11 +176,14 @@ static void nu_poll_out(const struct device *dev, unsigned char c)
 {
     struct nu_state *s = (struct nu_state *)dev->data;
     int ret = -1;
+    uint64_t io_start;
 
     LOG_DBG("%c", c);
 
     while (ret < 0) {
+        io_start = sim_rtf_io_begin();
         ret = write(s->tx_fd, (uint8_t *)&c, sizeof(c));
+        sim_rtf_io_end(io_start);
         if (ret < 0) {
             /* printk("write: %d, waiting...\n", ret); */
             k_msleep(1);
@@ -158,10 +195,13 @@ static int nu_poll_in(const struct device *dev, unsigned char *c)
 {
     struct nu_state *s = (struct nu_state *)dev->data;
     int ret = -1;
+    uint64_t io_start;
 
     LOG_DBG("");
 
+    io_start = sim_rtf_io_begin();
     ret = read(s->rx_fd, (uint8_t *)c, sizeof(*c));
+    sim_rtf_io_end(io_start);
     if (ret < 0) {
         return -errno;
     }
@@ -179,6 +219,8 @@ static void handle_rx_done(struct nu_state *s, bool complete)
 
     LOG_DBG("%s", complete ? "complete" : "not-complete");
 
+    SIM_TRACE_END("uart_rx", len, complete ? s->rx.pos : 0);
+
     /* allow rxing more from callback */
     s->rx.buf = NULL;
     s->rx.len = 0;
@@ -215,6 +257,8 @@ static void handle_tx_done(struct nu_state *s, bool complete)
 
     LOG_DBG("%s", complete ? "complete" : "not-complete");
 
+    SIM_TRACE_END("uart_tx", s->tx.len, complete);
+
     memset(&evt, 0, sizeof(evt));
 
     if (complete) {
@@ -236,6 +280,100 @@ static void handle_tx_done(struct nu_state *s, bool complete)
     s->cb(s->dev, &evt, s->ud);
 }
 
+#ifdef NU_TX_BATCH
+/* Write out as much of the batch as the pipe takes. Returns true once the
+ * batch is empty. Call with the batch lock held.
+ */
+static bool nu_batch_flush_locked(struct nu_state *s)
+{
+    int ret;
+    uint64_t io_start;
+
+    if (s->batch.pos < s->batch.len) {
+        SIM_TRACE_BEGIN("pipe_flush", s->batch.len - s->batch.pos, 0);
+        io_start = sim_rtf_io_begin();
+        ret = write(s->tx_fd,
+                s->batch.buf + s->batch.pos,
+                s->batch.len - s->batch.pos);
+        sim_rtf_io_end(io_start);
+        SIM_TRACE_END("pipe_flush", s->batch.len - s->batch.pos, MAX(ret, 0));
+
+        if (ret > 0) {
+            s->batch.pos += ret;
+            s->stats.tx_writes++;
+        }
+
+        LOG_DBG("flushed %zu out of %zu", s->batch.pos, s->batch.len);
+    }
+
+    if (s->batch.pos < s->batch.len) {
+        return false;
+    }
+
+    s->batch.pos = 0;
+    s->batch.len = 0;
+    k_timer_stop(&s->batch.flush);
+
+    return true;
+}
+
+static bool nu_batch_flush(struct nu_state *s)
+{
+    k_spinlock_key_t key = k_spin_lock(&s->batch.lock);
+    bool done = nu_batch_flush_locked(s);
+
+    k_spin_unlock(&s->batch.lock, key);
+
+    return done;
+}
+
+static void nu_batch_flush_work(struct k_timer *timer)
+{
+    struct nu_state *s = (struct nu_state *)k_timer_user_data_get(timer);
+
+    __ASSERT_NO_MSG(s);
+
+    if (!nu_batch_flush(s)) {
+        /* Pipe full, the other side is lagging */
+        k_timer_start(timer, RETRY_DELAY, K_NO_WAIT);
+    }
+}
+
+/* Copy `buf` at the end of the batch. Returns false if there is no room for
+ * it until the pipe has taken more of the batch.
+ */
+static bool nu_batch_append(struct nu_state *s, const uint8_t *buf, size_t len)
+{
+    k_spinlock_key_t key = k_spin_lock(&s->batch.lock);
+    bool fits;
+
+    if (s->batch.len + len > sizeof(s->batch.buf)) {
+        /* Size budget reached */
+        (void)nu_batch_flush_locked(s);
+    }
+
+    fits = s->batch.len + len <= sizeof(s->batch.buf);
+    if (fits) {
+        if (!s->batch.len) {
+            /* The latency budget starts with the first byte. The timer
+             * runs for as long as the batch isn't empty.
+             */
+            k_timer_start(&s->batch.flush,
+                          K_USEC(CONFIG_UART_POSIX_PIPE_TX_BATCH_US), K_NO_WAIT);
+        }
+
+        memcpy(s->batch.buf + s->batch.len, buf, len);
+        s->batch.len += len;
+        s->stats.tx_packets++;
+        s->stats.tx_bytes += len;
+    }
+
+    k_spin_unlock(&s->batch.lock, key);
+
+    return fits;
+}
+#endif /* NU_TX_BATCH */
+
 static void nu_expiry_work(struct k_timer *timer)
 {
     struct nu_state *s = (struct nu_state *)k_timer_user_data_get(timer);
@@ -258,19 +396,25 @@ static void nu_timer_work(struct k_timer *timer)
 {
     struct nu_state *s = (struct nu_state *)k_timer_user_data_get(timer);
     int ret;
+    uint64_t io_start;
 
     __ASSERT_NO_MSG(s);
 
     LOG_DBG("rx %p %d tx %p %d",
         s->rx.buf, s->rx.len, s->tx.buf, s->tx.len);
 
+    SIM_TRACE_INSTANT("uart_timer", s->rx.buf ? s->rx.len - s->rx.pos : 0,
+                      s->tx.buf ? s->tx.len - s->tx.pos : 0);
+
     /* TODO: handle disconnect from pipe */
 
     /* Try to RX first */
     if (s->rx.buf) {
+        io_start = sim_rtf_io_begin();
         ret = read(s->rx_fd,
                s->rx.buf + s->rx.pos,
                s->rx.len - s->rx.pos);
+        sim_rtf_io_end(io_start);
 
         if (ret >= 0) {
             s->rx.pos += ret;
@@ -286,17 +430,43 @@ static void nu_timer_work(struct k_timer *timer)
     }
 
     /* Then try to TX */
+#ifdef NU_TX_BATCH
+    if (s->tx.buf && s->tx.len <= sizeof(s->batch.buf)) {
+        /* Didn't fit in the batch when uart_tx() was called */
+        if (nu_batch_append(s, s->tx.buf, s->tx.len)) {
+            handle_tx_done(s, true);
+        } else {
+            k_timer_start(timer, RETRY_DELAY, K_FOREVER);
+        }
+
+        return;
+    }
+
+    if (s->tx.buf && !nu_batch_flush(s)) {
+        /* Larger than the batch: written directly, but only once what was
+         * queued before it is out.
+         */
+        k_timer_start(timer, RETRY_DELAY, K_FOREVER);
+        return;
+    }
+#endif /* NU_TX_BATCH */
+
     if (s->tx.buf) {
+        io_start = sim_rtf_io_begin();
         ret = write(s->tx_fd,
                 s->tx.buf + s->tx.pos,
                 s->tx.len - s->tx.pos);
+        sim_rtf_io_end(io_start);
 
         if (ret >= 0) {
             s->tx.pos += ret;
+            s->stats.tx_writes++;
             LOG_DBG("wrote %d out of %d", s->tx.pos, s->tx.len);
         }
 
         if (s->tx.pos == s->tx.len) {
+            s->stats.tx_packets++;
+            s->stats.tx_bytes += s->tx.len;
             handle_tx_done(s, true);
         } else {
             LOG_DBG("tx buf %p len %d ret %d", s->tx.buf, s->tx.len, ret);
@@ -328,6 +498,11 @@ static int nu_callback_set(const struct device *dev, uart_callback_t callback, v
     k_timer_init(&s->tx.expiry, nu_expiry_work, NULL);
     k_timer_user_data_set(&s->tx.expiry, s);
 
+#ifdef NU_TX_BATCH
+    k_timer_init(&s->batch.flush, nu_batch_flush_work, NULL);
+    k_timer_user_data_set(&s->batch.flush, s);
+#endif
+
     return 0;
 }
 
@@ -346,6 +521,27 @@ static int nu_tx(const struct device *dev, const uint8_t *buf, size_t len, int32
         return -EALREADY;
     }
 
+    SIM_TRACE_BEGIN("uart_tx", len, 0);
+
+#ifdef NU_TX_BATCH
+    if (len <= sizeof(s->batch.buf) && nu_batch_append(s, buf, len)) {
+        struct uart_event evt;
+
+        SIM_TRACE_END("uart_tx", len, 1);
+
+        /* The data is copied: report it sent right away, so the caller
+         * can queue the next buffer into the same batch.
+         */
+        memset(&evt, 0, sizeof(evt));
+        evt.type = UART_TX_DONE;
+        evt.data.tx.buf = buf;
+        evt.data.tx.len = len;
+        s->cb(s->dev, &evt, s->ud);
+
+        return 0;
+    }
+#endif /* NU_TX_BATCH */
+
     s->tx.buf = (uint8_t *)buf;
     s->tx.len = len;
     s->tx.pos = 0;
@@ -382,6 +578,8 @@ static int nu_rx_enable(const struct device *dev, uint8_t *buf, size_t len, int3
     s->rx.len = len;
     s->rx.pos = 0;
 
+    SIM_TRACE_BEGIN("uart_rx", len, 0);
+
     /* Always RX from ISR context */
     k_timer_start(&s->timer, K_NO_WAIT, K_NO_WAIT);
     if (timeout != SYS_FOREVER_US) {
@@ -409,6 +607,7 @@ static void nu_isr_timer_work(struct k_timer *timer)
 {
     struct nu_state *s = (struct nu_state *)k_timer_user_data_get(timer);
     int ret;
+    uint64_t io_start;
 
     LOG_DBG("");
 
@@ -417,7 +616,9 @@ static void nu_isr_timer_work(struct k_timer *timer)
 
     if (s->isr.rx.pending) {
         LOG_DBG("rx-pending");
+        io_start = sim_rtf_io_begin();
         ret = read(s->rx_fd, &s->isr.rx.c, 1);
+        sim_rtf_io_end(io_start);
         if (ret == 1) {
             s->isr.rx.pending = false;
             /* FIXME: that probably drops data */
@@ -434,7 +635,9 @@ static void nu_isr_timer_work(struct k_timer *timer)
 
     if (s->isr.tx.pending) {
         LOG_DBG("tx-pending");
+        io_start = sim_rtf_io_begin();
         ret = write(s->tx_fd, &s->isr.tx.c, 1);
+        sim_rtf_io_end(io_start);
         if (ret == 1) {
             s->isr.tx.pending = false;
             if (s->isr.tx.enabled) {
@@ -648,6 +851,23 @@ static struct uart_driver_api nu_api = {
 #endif    /* CONFIG_UART_INTERRUPT_DRIVEN */
 };
 
+static void nu_exit(struct nu_state *s, int n)
+{
+#ifdef CONFIG_UART_ASYNC_API
+#ifdef NU_TX_BATCH
+    /* Best effort, the other side may be gone already */
+    (void)nu_batch_flush(s);
+#endif
+
+    printk("METRICS {\"uart_pipe_%d\": {\"tx_packets\": %u, \"tx_writes\": %u, "
+           "\"tx_bytes\": %llu}}\n",
+           n, s->stats.tx_packets, s->stats.tx_writes, s->stats.tx_bytes);
+#endif
+
+    close(s->rx_fd);
+    close(s->tx_fd);
+}
+
 #define UART_NATIVE_CMDLINE_ADD(n)                                      \
     static void nu_##n##_extra_cmdline_opts(void)                       \
     {                                                                   \
@@ -674,8 +894,7 @@ static struct uart_driver_api nu_api = {
                                                                         \
     static void nu_##n##_cleanup(void)                                  \
     {                                                                   \
-        close(nu_##n##_state.rx_fd);                                    \
-        close(nu_##n##_state.tx_fd);                                    \
+        nu_exit(&nu_##n##_state, n);                                    \
     }                                                                   \
                                                                         \
     NATIVE_TASK(nu_##n##_extra_cmdline_opts, PRE_BOOT_1, 11);           \
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/random/random.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/hci.h>
+
+#include "cmdline.h" /* native_posix command line options header */
+#include "posix_native_task.h"
+
+/* AD element: 1 byte length, 1 byte type, up to 254 bytes of data */
+#define AD_ELEM_MAX      (2U + 254U)
+#define AD_LEN_MAX       CONFIG_BT_CTLR_ADV_DATA_LEN_MAX
+#define AD_ELEM_COUNT    DIV_ROUND_UP(AD_LEN_MAX, AD_ELEM_MAX)
+#define LEGACY_AD_LEN    31U
+
+static bool adv_ext;
+static uint32_t adv_len = LEGACY_AD_LEN;
+static uint32_t adv_interval_min_ms = 20U;
+static uint32_t adv_interval_max_ms = 100U;
+
+static uint8_t payload[AD_LEN_MAX];
+static struct bt_data ad[AD_ELEM_COUNT];
+
+static void adv_extra_cmdline_opts(void)
+{
+	static struct args_struct_t adv_opts[] = {
+		{
+			.is_switch = true,
+			.option = "adv_ext",
+			.type = 'b',
+			.dest = (void *)&adv_ext,
+			.descript = "Use extended advertising (default: legacy)",
+		},
+		{
+			.option = "adv_len",
+			.name = "bytes",
+			.type = 'u',
+			.dest = (void *)&adv_len,
+			.descript = "Total AD payload length (legacy: max 31, extended: max "
+				    STRINGIFY(CONFIG_BT_CTLR_ADV_DATA_LEN_MAX) ")",
+		},
+		{
+			.option = "adv_interval_min",
+			.name = "ms",
+			.type = 'u',
+			.dest = (void *)&adv_interval_min_ms,
+			.descript = "Lower bound of the random advertising interval",
+		},
+		{
+			.option = "adv_interval_max",
+			.name = "ms",
+			.type = 'u',
+			.dest = (void *)&adv_interval_max_ms,
+			.descript = "Upper bound of the random advertising interval",
+		},
+		ARG_TABLE_ENDMARKER
+	};
+
+	native_add_command_line_opts(adv_opts);
+}
+
+NATIVE_TASK(adv_extra_cmdline_opts, PRE_BOOT_1, 10);
+
+/* Split `len` bytes of AD into manufacturer specific data elements */
+static size_t build_ad(size_t len)
+{
+	size_t count = 0;
+	size_t pos = 0;
+
+	for (size_t i = 0; i < sizeof(payload); i++) {
+		payload[i] = (uint8_t)i;
+	}
+
+	while (len - pos >= 2U && count < ARRAY_SIZE(ad)) {
+		size_t elem = MIN(len - pos, AD_ELEM_MAX);
+
+		ad[count].type = BT_DATA_MANUFACTURER_DATA;
+		ad[count].data_len = elem - 2U;
+		ad[count].data = &payload[pos];
+
+		pos += elem;
+		count++;
+	}
+
+	return count;
+}
+
+int main(void)
+{
+	struct bt_le_adv_param param = {
+		.id = BT_ID_DEFAULT,
+		.options = BT_LE_ADV_OPT_USE_IDENTITY,
+	};
+	struct bt_le_ext_adv *adv;
+	uint32_t interval_ms;
+	size_t ad_count;
+	int err;
+
+	err = bt_enable(NULL);
+	if (err) {
+		printk("Bluetooth init failed (err %d)\n", err);
+		return 0;
+	}
+
+	if (adv_ext) {
+		param.options |= BT_LE_ADV_OPT_EXT_ADV;
+		adv_len = MIN(adv_len, AD_LEN_MAX);
+	} else {
+		adv_len = MIN(adv_len, LEGACY_AD_LEN);
+	}
+
+	adv_interval_max_ms = MAX(adv_interval_max_ms, adv_interval_min_ms);
+	interval_ms = adv_interval_min_ms +
+		      sys_rand32_get() % (adv_interval_max_ms - adv_interval_min_ms + 1U);
+
+	/* Advertising interval is in units of 0.625 ms */
+	param.interval_min = interval_ms * 8U / 5U;
+	param.interval_max = param.interval_min;
+
+	ad_count = build_ad(adv_len);
+
+	printk("Advertising: %s, AD len %u, interval %u ms\n",
+	       adv_ext ? "extended" : "legacy", adv_len, interval_ms);
+
+	err = bt_le_ext_adv_create(&param, NULL, &adv);
+	if (err) {
+		printk("Failed to create advertising set (err %d)\n", err);
+		return 0;
+	}
+
+	err = bt_le_ext_adv_set_data(adv, ad, ad_count, NULL, 0);
+	if (err) {
+		printk("Failed to set advertising data (err %d)\n", err);
+		return 0;
+	}
+
+	err = bt_le_ext_adv_start(adv, BT_LE_EXT_ADV_START_DEFAULT);
+	if (err) {
+		printk("Failed to start advertising (err %d)\n", err);
+		return 0;
+	}
+
+	return 0;
+}
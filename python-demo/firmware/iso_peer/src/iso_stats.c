@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * ISO SDU reception statistics.
+ *
+ * The host sends one SDU per SDU interval, numbered from 0, so SDU `seq` is
+ * due `seq * interval` after the first one. The "offset" of an SDU is its
+ * arrival time minus that: it is constant if every SDU takes the same time to
+ * arrive. The smallest offset seen is the best case, and the delay of an SDU
+ * is how far its offset is above it.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "posix_native_task.h"
+
+#include "iso_stats.h"
+
+struct stream_stats {
+	uint32_t rx;
+	uint32_t lost;
+	uint32_t errors;
+	uint32_t late;
+	uint32_t bytes;
+	uint32_t interval_us;
+	bool started;
+	uint32_t last_seq;
+	int64_t last_offset;
+	int64_t min_offset;
+	int64_t max_offset;
+	int64_t offset_sum;
+	/* RFC 3550 estimator, scaled by 16 */
+	int64_t jitter16;
+};
+
+static struct stream_stats streams[ISO_STREAM_COUNT];
+
+static const char *const stream_names[ISO_STREAM_COUNT] = {
+	[ISO_STREAM_CIS] = "cis",
+	[ISO_STREAM_BIS] = "bis",
+};
+
+void iso_stats_rx(enum iso_stream stream, bool valid, const uint8_t *data, uint16_t len,
+		  int64_t now_us)
+{
+	struct stream_stats *s = &streams[stream];
+	uint32_t seq;
+	int64_t offset;
+	int64_t d;
+
+	if (!valid) {
+		/* The sequence gap accounts for it once the next one arrives */
+		s->errors++;
+		return;
+	}
+
+	if (len < ISO_SDU_HDR_LEN) {
+		s->errors++;
+		return;
+	}
+
+	seq = sys_get_le32(&data[0]);
+	s->interval_us = sys_get_le32(&data[4]);
+	offset = now_us - (int64_t)seq * s->interval_us;
+
+	if (s->started && seq <= s->last_seq) {
+		/* Duplicate or out of order, not expected on ISO */
+		s->errors++;
+		return;
+	}
+
+	s->rx++;
+	s->bytes += len;
+
+	if (!s->started) {
+		/* Whatever was sent before we were in sync isn't lost */
+		s->started = true;
+		s->min_offset = offset;
+		s->max_offset = offset;
+	} else {
+		s->lost += seq - s->last_seq - 1U;
+
+		d = offset - s->last_offset;
+		s->jitter16 += (d < 0 ? -d : d) - ((s->jitter16 + 8) >> 4);
+	}
+
+	if (offset - s->min_offset > s->interval_us) {
+		s->late++;
+	}
+
+	s->min_offset = MIN(s->min_offset, offset);
+	s->max_offset = MAX(s->max_offset, offset);
+	s->offset_sum += offset;
+	s->last_offset = offset;
+	s->last_seq = seq;
+}
+
+static void iso_stats_print(void)
+{
+	printk("METRICS {\"iso\": {");
+
+	for (size_t i = 0; i < ARRAY_SIZE(streams); i++) {
+		struct stream_stats *s = &streams[i];
+		int64_t avg = s->rx ? s->offset_sum / s->rx - s->min_offset : 0;
+
+		printk("%s\"%s\": {\"rx\": %u, \"lost\": %u, \"errors\": %u, \"late\": %u, "
+		       "\"bytes\": %u, \"sdu_interval_us\": %u, \"delay_avg_us\": %lld, "
+		       "\"delay_max_us\": %lld, \"jitter_us\": %lld}",
+		       i ? ", " : "", stream_names[i], s->rx, s->lost, s->errors, s->late,
+		       s->bytes, s->interval_us, avg, s->max_offset - s->min_offset,
+		       s->jitter16 >> 4);
+	}
+
+	printk("}}\n");
+}
+
+NATIVE_TASK(iso_stats_print, ON_EXIT, 10);
@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ISO_STATS_H_
+#define ISO_STATS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Header the python host puts at the start of every SDU */
+#define ISO_SDU_HDR_LEN 8U
+
+enum iso_stream {
+	ISO_STREAM_CIS,
+	ISO_STREAM_BIS,
+	ISO_STREAM_COUNT,
+};
+
+/* Account one SDU received at `now_us` (simulated time). `valid` is false if
+ * the controller flagged it as lost or in error, in which case `data` may be
+ * NULL.
+ */
+void iso_stats_rx(enum iso_stream stream, bool valid, const uint8_t *data, uint16_t len,
+		  int64_t now_us);
+
+#endif /* ISO_STATS_H_ */
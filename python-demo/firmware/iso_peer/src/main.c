@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/iso.h>
+
+#include "iso_stats.h"
+
+/* The python host connects to this address, see iso_bench.py */
+#define PEER_ADDR "C0:00:00:00:15:01"
+
+/* Name of the host's periodic advertiser carrying the BIG */
+#define BROADCASTER_NAME "iso_bench"
+
+static const struct bt_data ad[] = {
+	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
+	BT_DATA(BT_DATA_NAME_COMPLETE, CONFIG_BT_DEVICE_NAME, sizeof(CONFIG_BT_DEVICE_NAME) - 1),
+};
+
+static struct bt_le_per_adv_sync *pa_sync;
+static struct bt_iso_big *big;
+
+static void adv_work_handler(struct k_work *work)
+{
+	int err;
+
+	err = bt_le_adv_start(BT_LE_ADV_CONN_ONE_TIME, ad, ARRAY_SIZE(ad), NULL, 0);
+	if (err && err != -EALREADY) {
+		printk("Advertising failed to start (err %d)\n", err);
+	}
+}
+
+static K_WORK_DEFINE(adv_work, adv_work_handler);
+
+static void iso_recv(struct bt_iso_chan *chan, const struct bt_iso_recv_info *info,
+		     struct net_buf *buf);
+static void iso_connected(struct bt_iso_chan *chan);
+static void iso_disconnected(struct bt_iso_chan *chan, uint8_t reason);
+
+static struct bt_iso_chan_ops iso_ops = {
+	.recv = iso_recv,
+	.connected = iso_connected,
+	.disconnected = iso_disconnected,
+};
+
+static struct bt_iso_chan_io_qos cis_rx_qos;
+static struct bt_iso_chan_qos cis_qos = {
+	.rx = &cis_rx_qos,
+};
+static struct bt_iso_chan cis_chan = {
+	.ops = &iso_ops,
+	.qos = &cis_qos,
+};
+
+static struct bt_iso_chan_io_qos bis_rx_qos;
+static struct bt_iso_chan_qos bis_qos = {
+	.rx = &bis_rx_qos,
+};
+static struct bt_iso_chan bis_chan = {
+	.ops = &iso_ops,
+	.qos = &bis_qos,
+};
+static struct bt_iso_chan *bis_channels[] = {&bis_chan};
+
+static void iso_recv(struct bt_iso_chan *chan, const struct bt_iso_recv_info *info,
+		     struct net_buf *buf)
+{
+	int64_t now_us = k_ticks_to_us_floor64(k_uptime_ticks());
+	bool valid = (info->flags & BT_ISO_FLAGS_VALID) && buf->len;
+
+	iso_stats_rx(chan == &cis_chan ? ISO_STREAM_CIS : ISO_STREAM_BIS, valid,
+		     buf->data, buf->len, now_us);
+}
+
+static void iso_connected(struct bt_iso_chan *chan)
+{
+	printk("%s stream established\n", chan == &cis_chan ? "CIS" : "BIS");
+}
+
+static void iso_disconnected(struct bt_iso_chan *chan, uint8_t reason)
+{
+	printk("%s stream terminated (reason 0x%02x)\n",
+	       chan == &cis_chan ? "CIS" : "BIS", reason);
+
+	if (chan == &bis_chan) {
+		/* The host frees the BIG when its last BIS goes, sync again
+		 * on the next BIGInfo.
+		 */
+		big = NULL;
+	}
+}
+
+static int iso_accept(const struct bt_iso_accept_info *info, struct bt_iso_chan **chan)
+{
+	if (cis_chan.iso) {
+		return -ENOMEM;
+	}
+
+	*chan = &cis_chan;
+
+	return 0;
+}
+
+static struct bt_iso_server iso_server = {
+#if defined(CONFIG_BT_SMP)
+	.sec_level = BT_SECURITY_L1,
+#endif
+	.accept = iso_accept,
+};
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+	if (err) {
+		printk("Connection failed (err 0x%02x)\n", err);
+		return;
+	}
+
+	printk("Connected\n");
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	printk("Disconnected (reason 0x%02x)\n", reason);
+}
+
+static void recycled(void)
+{
+	k_work_submit(&adv_work);
+}
+
+BT_CONN_CB_DEFINE(conn_callbacks) = {
+	.connected = connected,
+	.disconnected = disconnected,
+	.recycled = recycled,
+};
+
+static bool name_matches(struct bt_data *data, void *user_data)
+{
+	bool *found = user_data;
+
+	if ((data->type == BT_DATA_NAME_COMPLETE || data->type == BT_DATA_NAME_SHORTENED) &&
+	    data->data_len == strlen(BROADCASTER_NAME) &&
+	    !memcmp(data->data, BROADCASTER_NAME, data->data_len)) {
+		*found = true;
+		return false;
+	}
+
+	return true;
+}
+
+static void scan_recv(const struct bt_le_scan_recv_info *info, struct net_buf_simple *ad)
+{
+	struct bt_le_per_adv_sync_param param = {
+		.sid = info->sid,
+		.skip = 0,
+		/* 10 ms units */
+		.timeout = 100,
+	};
+	bool found = false;
+	int err;
+
+	if (pa_sync || !info->interval) {
+		return;
+	}
+
+	bt_data_parse(ad, name_matches, &found);
+	if (!found) {
+		return;
+	}
+
+	bt_addr_le_copy(&param.addr, info->addr);
+
+	err = bt_le_per_adv_sync_create(&param, &pa_sync);
+	if (err) {
+		printk("Periodic advertising sync failed to start (err %d)\n", err);
+		pa_sync = NULL;
+		return;
+	}
+
+	printk("Syncing to the broadcaster\n");
+}
+
+static struct bt_le_scan_cb scan_callbacks = {
+	.recv = scan_recv,
+};
+
+static void pa_synced(struct bt_le_per_adv_sync *sync,
+		      struct bt_le_per_adv_sync_synced_info *info)
+{
+	printk("Synced to periodic advertising\n");
+}
+
+static void pa_term(struct bt_le_per_adv_sync *sync,
+		    const struct bt_le_per_adv_sync_term_info *info)
+{
+	printk("Periodic advertising sync lost (reason 0x%02x)\n", info->reason);
+
+	/* Scanning is still on, so we sync again as soon as it shows up */
+	pa_sync = NULL;
+}
+
+static void biginfo_recv(struct bt_le_per_adv_sync *sync, const struct bt_iso_biginfo *biginfo)
+{
+	struct bt_iso_big_sync_param param = {
+		.bis_channels = bis_channels,
+		.num_bis = ARRAY_SIZE(bis_channels),
+		/* BIS index 1 */
+		.bis_bitfield = BIT(0),
+		.mse = BT_ISO_SYNC_MSE_ANY,
+		/* 10 ms units */
+		.sync_timeout = 100,
+	};
+	int err;
+
+	/* BIGInfo comes with every periodic advertising event */
+	if (big) {
+		return;
+	}
+
+	err = bt_iso_big_sync(sync, &param, &big);
+	if (err) {
+		printk("BIG sync failed (err %d)\n", err);
+		big = NULL;
+		return;
+	}
+
+	printk("Syncing to BIG: %u BIS, SDU interval %u us, max SDU %u\n",
+	       biginfo->num_bis, biginfo->sdu_interval, biginfo->max_sdu);
+}
+
+static struct bt_le_per_adv_sync_cb pa_callbacks = {
+	.synced = pa_synced,
+	.term = pa_term,
+	.biginfo = biginfo_recv,
+};
+
+int main(void)
+{
+	bt_addr_le_t addr;
+	int err;
+
+	/* Fixed identity, so the host doesn't have to scan for us */
+	bt_addr_le_from_str(PEER_ADDR, "random", &addr);
+
+	err = bt_id_create(&addr, NULL);
+	if (err < 0) {
+		printk("Failed to set the identity address (err %d)\n", err);
+		return 0;
+	}
+
+	err = bt_enable(NULL);
+	if (err) {
+		printk("Bluetooth init failed (err %d)\n", err);
+		return 0;
+	}
+
+	err = bt_iso_server_register(&iso_server);
+	if (err) {
+		printk("ISO server registration failed (err %d)\n", err);
+		return 0;
+	}
+
+	bt_le_scan_cb_register(&scan_callbacks);
+	bt_le_per_adv_sync_cb_register(&pa_callbacks);
+
+	err = bt_le_scan_start(BT_LE_SCAN_PASSIVE, NULL);
+	if (err) {
+		printk("Scanning failed to start (err %d)\n", err);
+		return 0;
+	}
+
+	k_work_submit(&adv_work);
+
+	printk("iso_peer ready\n");
+
+	return 0;
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/bluetooth/bluetooth.h>
+
+#if defined(CONFIG_ARCH_POSIX)
+#include "posix_native_task.h"
+#endif
+
+#include "dedup.h"
+#include "fnv.h"
+
+#define CAPACITY CONFIG_OBSERVER_DEDUP_CAPACITY
+#define NIL      UINT16_MAX
+
+BUILD_ASSERT(IS_POWER_OF_TWO(CAPACITY), "Dedup capacity must be a power of two");
+BUILD_ASSERT(CAPACITY < NIL, "Dedup capacity too large for 16-bit indices");
+
+struct dedup_entry {
+	bt_addr_le_t addr;
+	uint8_t sid;
+	uint16_t len;
+	uint32_t ad_hash;
+
+	/* Next entry in the same hash bucket */
+	uint16_t chain;
+	/* LRU list, head is the most recently used */
+	uint16_t prev;
+	uint16_t next;
+};
+
+static struct dedup_entry entries[CAPACITY];
+static uint16_t buckets[CAPACITY];
+static uint16_t lru_head = NIL;
+static uint16_t lru_tail = NIL;
+static uint16_t used;
+
+static uint32_t hits;
+static uint32_t misses;
+static uint32_t evictions;
+
+static uint32_t key_hash(const bt_addr_le_t *addr, uint8_t sid)
+{
+	uint32_t h = fnv1a_32(FNV1A_32_INIT, addr, sizeof(*addr));
+
+	return fnv1a_32(h, &sid, sizeof(sid));
+}
+
+static void lru_unlink(uint16_t i)
+{
+	struct dedup_entry *e = &entries[i];
+
+	if (e->prev != NIL) {
+		entries[e->prev].next = e->next;
+	} else {
+		lru_head = e->next;
+	}
+
+	if (e->next != NIL) {
+		entries[e->next].prev = e->prev;
+	} else {
+		lru_tail = e->prev;
+	}
+}
+
+static void lru_push_front(uint16_t i)
+{
+	struct dedup_entry *e = &entries[i];
+
+	e->prev = NIL;
+	e->next = lru_head;
+
+	if (lru_head != NIL) {
+		entries[lru_head].prev = i;
+	}
+	lru_head = i;
+
+	if (lru_tail == NIL) {
+		lru_tail = i;
+	}
+}
+
+static void bucket_remove(uint16_t i)
+{
+	struct dedup_entry *e = &entries[i];
+	uint16_t *link = &buckets[key_hash(&e->addr, e->sid) & (CAPACITY - 1U)];
+
+	while (*link != i) {
+		__ASSERT_NO_MSG(*link != NIL);
+		link = &entries[*link].chain;
+	}
+
+	*link = e->chain;
+}
+
+static uint16_t alloc_entry(void)
+{
+	uint16_t i;
+
+	if (used < CAPACITY) {
+		return used++;
+	}
+
+	/* Recycle the advertiser we haven't heard from for the longest */
+	i = lru_tail;
+	lru_unlink(i);
+	bucket_remove(i);
+	evictions++;
+
+	return i;
+}
+
+bool dedup_check(const bt_addr_le_t *addr, uint8_t sid,
+		 const uint8_t *data, uint16_t len)
+{
+	uint32_t bucket = key_hash(addr, sid) & (CAPACITY - 1U);
+	uint32_t ad_hash = fnv1a_32(FNV1A_32_INIT, data, len);
+	struct dedup_entry *e;
+	uint16_t i;
+
+	for (i = buckets[bucket]; i != NIL; i = entries[i].chain) {
+		e = &entries[i];
+
+		if (e->sid == sid && bt_addr_le_eq(&e->addr, addr)) {
+			break;
+		}
+	}
+
+	if (i != NIL) {
+		lru_unlink(i);
+		lru_push_front(i);
+
+		if (e->len == len && e->ad_hash == ad_hash) {
+			hits++;
+			return true;
+		}
+
+		e->len = len;
+		e->ad_hash = ad_hash;
+		misses++;
+		return false;
+	}
+
+	i = alloc_entry();
+	e = &entries[i];
+
+	bt_addr_le_copy(&e->addr, addr);
+	e->sid = sid;
+	e->len = len;
+	e->ad_hash = ad_hash;
+
+	e->chain = buckets[bucket];
+	buckets[bucket] = i;
+	lru_push_front(i);
+	misses++;
+
+	return false;
+}
+
+void dedup_print(void)
+{
+	printk("[DEDUP] %u advertisers cached, %u duplicates dropped, %u passed, %u evicted\n",
+	       used, hits, misses, evictions);
+}
+
+static int dedup_init(void)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(buckets); i++) {
+		buckets[i] = NIL;
+	}
+
+	return 0;
+}
+
+SYS_INIT(dedup_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#if defined(CONFIG_ARCH_POSIX)
+NATIVE_TASK(dedup_print, ON_EXIT, 11);
+#endif
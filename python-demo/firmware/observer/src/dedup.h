@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef DEDUP_H_
+#define DEDUP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/bluetooth/addr.h>
+
+/* Look up the last AD payload seen from (addr, sid).
+ *
+ * Returns true if the payload is the same as last time, i.e. the report can
+ * be dropped without parsing it. Otherwise the new payload is remembered and
+ * false is returned. The least recently seen advertiser is evicted when the
+ * cache is full.
+ */
+bool dedup_check(const bt_addr_le_t *addr, uint8_t sid,
+		 const uint8_t *data, uint16_t len);
+
+/* Print hit/miss/eviction counters */
+void dedup_print(void);
+
+#endif /* DEDUP_H_ */
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FNV_H_
+#define FNV_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FNV1A_32_INIT 2166136261U
+
+/* 32-bit FNV-1a. Chain calls by passing the previous result as `h`. */
+static inline uint32_t fnv1a_32(uint32_t h, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+
+	for (size_t i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= 16777619U;
+	}
+
+	return h;
+}
+
+#endif /* FNV_H_ */
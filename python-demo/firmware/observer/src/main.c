@@ -11,10 +11,17 @@
 
 #include <zephyr/logging/log.h>
 
+#include "dedup.h"
+#include "report_batch.h"
+#include "scan_bench.h"
+#include "scan_stats.h"
+#include "sim_trace.h"
+
 LOG_MODULE_REGISTER(observer, LOG_LEVEL_INF);
 
 #define NAME_LEN 30
 
+#if !defined(CONFIG_BT_EXT_ADV)
 static void device_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
 			 struct net_buf_simple *ad)
 {
@@ -24,8 +31,12 @@ static void device_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
 	printk("Device found: %s (RSSI %d), type %u, AD data len %u\n",
 	       addr_str, rssi, type, ad->len);
 }
+#else
+/* Every report goes through scan_recv() only, device_found() would see each
+ * one a second time.
+ */
+#define device_found NULL
 
-#if defined(CONFIG_BT_EXT_ADV)
 static bool data_cb(struct bt_data *data, void *user_data)
 {
 	char *name = user_data;
@@ -54,22 +65,34 @@ static const char *phy2str(uint8_t phy)
 	}
 }
 
-static void scan_recv(const struct bt_le_scan_recv_info *info,
-		      struct net_buf_simple *buf)
+static void process_report(const struct bt_le_scan_recv_info *info,
+			   struct net_buf_simple *buf)
 {
 	char le_addr[BT_ADDR_LE_STR_LEN];
 	char name[NAME_LEN];
 	uint8_t data_status;
 	uint16_t data_len;
 
+	if (IS_ENABLED(CONFIG_OBSERVER_SCAN_STATS)) {
+		scan_stats_record(info->addr, info->rssi, info->primary_phy,
+				  info->secondary_phy, info->sid, buf->len);
+		return;
+	}
+
+	data_status = BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS(info->adv_props);
+
+	if (IS_ENABLED(CONFIG_OBSERVER_DEDUP) &&
+	    data_status == BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS_COMPLETE &&
+	    dedup_check(info->addr, info->sid, buf->data, buf->len)) {
+		return;
+	}
+
 	(void)memset(name, 0, sizeof(name));
 
 	LOG_HEXDUMP_DBG(buf->data, buf->len, "AD data");
 	data_len = buf->len;
 	bt_data_parse(buf, data_cb, name);
 
-	data_status = BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS(info->adv_props);
-
 	bt_addr_le_to_str(info->addr, le_addr, sizeof(le_addr));
 	printk("[DEVICE]: %s, AD evt type %u, Tx Pwr: %i, RSSI %i "
 	       "Data status: %u, AD data len: %u Name: %s "
@@ -86,6 +109,70 @@ static void scan_recv(const struct bt_le_scan_recv_info *info,
 	       info->interval, info->interval * 5 / 4, info->sid);
 }
 
+/* With the scan benchmark, processing is timed wherever it runs: in the scan
+ * callback, or on the batch workqueue.
+ */
+static void handle_report(const struct bt_le_scan_recv_info *info,
+			  struct net_buf_simple *buf)
+{
+	uint64_t cpu_ns;
+
+	if (!IS_ENABLED(CONFIG_OBSERVER_SCAN_BENCH)) {
+		process_report(info, buf);
+		return;
+	}
+
+	cpu_ns = scan_bench_cpu_ns();
+	process_report(info, buf);
+	scan_bench_processed(scan_bench_cpu_ns() - cpu_ns);
+}
+
+/* Returns false if the report was dropped, the batch being full */
+static bool deliver_report(const struct bt_le_scan_recv_info *info,
+			   struct net_buf_simple *buf)
+{
+	if (IS_ENABLED(CONFIG_OBSERVER_BATCH)) {
+		return report_batch_add(info, buf);
+	}
+
+	handle_report(info, buf);
+
+	return true;
+}
+
+static void scan_recv(const struct bt_le_scan_recv_info *info,
+		      struct net_buf_simple *buf)
+{
+	uint8_t data_status = BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS(info->adv_props);
+	uint64_t cpu_ns;
+	uint16_t len;
+	bool delivered;
+
+	SIM_TRACE_INSTANT("scan_recv", buf->len, data_status);
+
+	if (!IS_ENABLED(CONFIG_OBSERVER_SCAN_BENCH)) {
+		(void)deliver_report(info, buf);
+		return;
+	}
+
+	/* Processing may consume the buffer */
+	len = buf->len;
+
+	cpu_ns = scan_bench_cpu_ns();
+	delivered = deliver_report(info, buf);
+	cpu_ns = scan_bench_cpu_ns() - cpu_ns;
+
+	if (!delivered) {
+		scan_bench_drop();
+		return;
+	}
+
+	/* Without batching, the callback's time is the processing, already
+	 * accounted by handle_report()
+	 */
+	scan_bench_record(data_status, len, IS_ENABLED(CONFIG_OBSERVER_BATCH) ? cpu_ns : 0U);
+}
+
 static struct bt_le_scan_cb scan_callbacks = {
 	.recv = scan_recv,
 };
@@ -102,6 +189,10 @@ int observer_start(void)
 	int err;
 
 #if defined(CONFIG_BT_EXT_ADV)
+	if (IS_ENABLED(CONFIG_OBSERVER_BATCH)) {
+		report_batch_init(handle_report);
+	}
+
 	bt_le_scan_cb_register(&scan_callbacks);
 	printk("Registered scan callbacks\n");
 #endif /* CONFIG_BT_EXT_ADV */
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Scan report batching.
+ *
+ * The scan callback runs in the host's RX context, and the report's buffer is
+ * only released once it returns. So it only copies the report into one of two
+ * preallocated batch buffers. A dedicated workqueue swaps the buffers and
+ * processes the full one (decoding, filtering, aggregation, printing) while
+ * the RX side fills the other one.
+ */
+
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/bluetooth/bluetooth.h>
+
+#if defined(CONFIG_ARCH_POSIX)
+#include "posix_native_task.h"
+#endif
+
+#include "report_batch.h"
+
+#define BUF_SIZE CONFIG_OBSERVER_BATCH_BUF_SIZE
+
+struct report {
+	struct bt_le_scan_recv_info info;
+	bt_addr_le_t addr;
+	uint16_t len;
+	uint8_t data[];
+};
+
+struct batch {
+	size_t len;
+	uint32_t reports;
+	uint8_t buf[BUF_SIZE] __aligned(sizeof(void *));
+};
+
+static struct batch batches[2];
+/* The batch the RX side fills */
+static struct batch *filling = &batches[0];
+static struct k_spinlock lock;
+
+static report_batch_handler_t handler;
+
+static uint32_t batch_count;
+static uint32_t batch_reports_max;
+static uint64_t reports;
+static uint64_t dropped;
+
+static K_THREAD_STACK_DEFINE(batch_stack, CONFIG_OBSERVER_BATCH_STACK_SIZE);
+static struct k_work_q batch_wq;
+
+static void batch_work_handler(struct k_work *work);
+
+static K_WORK_DEFINE(batch_work, batch_work_handler);
+
+static size_t report_size(uint16_t len)
+{
+	return ROUND_UP(sizeof(struct report) + len, sizeof(void *));
+}
+
+bool report_batch_add(const struct bt_le_scan_recv_info *info,
+		      const struct net_buf_simple *buf)
+{
+	size_t size = report_size(buf->len);
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct batch *b = filling;
+	struct report *r;
+
+	if (b->len + size > sizeof(b->buf)) {
+		dropped++;
+		k_spin_unlock(&lock, key);
+		return false;
+	}
+
+	r = (struct report *)&b->buf[b->len];
+	r->info = *info;
+	bt_addr_le_copy(&r->addr, info->addr);
+	r->len = buf->len;
+	memcpy(r->data, buf->data, buf->len);
+
+	b->len += size;
+	b->reports++;
+	reports++;
+
+	k_spin_unlock(&lock, key);
+
+	/* No-op if already queued. If it's running, it runs once more and
+	 * picks this report up.
+	 */
+	k_work_submit_to_queue(&batch_wq, &batch_work);
+
+	return true;
+}
+
+static void batch_work_handler(struct k_work *work)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct batch *b = filling;
+	struct net_buf_simple nbs;
+	size_t pos = 0;
+
+	filling = (b == &batches[0]) ? &batches[1] : &batches[0];
+
+	k_spin_unlock(&lock, key);
+
+	if (!b->reports) {
+		return;
+	}
+
+	batch_count++;
+	batch_reports_max = MAX(batch_reports_max, b->reports);
+
+	while (pos < b->len) {
+		struct report *r = (struct report *)&b->buf[pos];
+
+		r->info.addr = &r->addr;
+		net_buf_simple_init_with_data(&nbs, r->data, r->len);
+		handler(&r->info, &nbs);
+
+		pos += report_size(r->len);
+	}
+
+	/* The RX side only writes to `filling`: this batch is ours until the
+	 * next run of this handler swaps it back
+	 */
+	b->len = 0;
+	b->reports = 0;
+}
+
+void report_batch_init(report_batch_handler_t report_handler)
+{
+	handler = report_handler;
+
+	k_work_queue_start(&batch_wq, batch_stack, K_THREAD_STACK_SIZEOF(batch_stack),
+			   CONFIG_OBSERVER_BATCH_PRIO, NULL);
+	k_thread_name_set(&batch_wq.thread, "report_batch");
+}
+
+void report_batch_print(void)
+{
+	printk("[BATCH] %llu reports in %u batches (max %u per batch), %llu dropped\n",
+	       reports, batch_count, batch_reports_max, dropped);
+	printk("METRICS {\"report_batch\": {\"reports\": %llu, \"batches\": %u, "
+	       "\"batch_reports_max\": %u, \"dropped\": %llu}}\n",
+	       reports, batch_count, batch_reports_max, dropped);
+}
+
+#if defined(CONFIG_ARCH_POSIX)
+NATIVE_TASK(report_batch_print, ON_EXIT, 10);
+#endif
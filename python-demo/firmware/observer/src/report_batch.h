@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef REPORT_BATCH_H_
+#define REPORT_BATCH_H_
+
+#include <stdbool.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/net/buf.h>
+
+/* Called from the batch workqueue for every report, in reception order.
+ * `info` and `buf` point into the batch and are only valid during the call.
+ */
+typedef void (*report_batch_handler_t)(const struct bt_le_scan_recv_info *info,
+				       struct net_buf_simple *buf);
+
+/* Start the batch workqueue. `handler` processes the reports. */
+void report_batch_init(report_batch_handler_t handler);
+
+/* Copy a report into the batch being filled and have it processed later.
+ * Doesn't block: returns false and counts the report as dropped if the batch
+ * is full.
+ */
+bool report_batch_add(const struct bt_le_scan_recv_info *info,
+		      const struct net_buf_simple *buf);
+
+/* Print batch and drop counters, and a METRICS line */
+void report_batch_print(void);
+
+#endif /* REPORT_BATCH_H_ */
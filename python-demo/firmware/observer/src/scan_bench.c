@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <time.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/bluetooth/hci.h>
+
+#include "posix_native_task.h"
+
+#include "scan_bench.h"
+
+static struct {
+	int64_t first_ms;
+	int64_t last_ms;
+	uint64_t reports;
+	uint64_t bytes;
+	uint64_t complete;
+	uint64_t complete_bytes;
+	uint64_t partial;
+	uint64_t truncated;
+	uint64_t dropped;
+	uint64_t processed;
+	uint64_t cb_cpu_ns;
+	uint64_t cb_copy_ns;
+	uint64_t start_cpu_ns;
+} bench;
+
+uint64_t scan_bench_cpu_ns(void)
+{
+	struct timespec ts;
+
+	/* Simulated time doesn't advance while we run, so the only meaningful
+	 * cost of a report is the real CPU time the simulator process spends.
+	 */
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+	return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+void scan_bench_record(uint8_t data_status, uint16_t data_len, uint64_t copy_ns)
+{
+	int64_t now = k_uptime_get();
+
+	if (!bench.reports) {
+		bench.first_ms = now;
+	}
+	bench.last_ms = now;
+
+	bench.reports++;
+	bench.bytes += data_len;
+	bench.cb_copy_ns += copy_ns;
+
+	switch (data_status) {
+	case BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS_COMPLETE:
+		bench.complete++;
+		bench.complete_bytes += data_len;
+		break;
+	case BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS_PARTIAL:
+		bench.partial++;
+		break;
+	default:
+		bench.truncated++;
+		break;
+	}
+}
+
+void scan_bench_processed(uint64_t cpu_ns)
+{
+	bench.processed++;
+	bench.cb_cpu_ns += cpu_ns;
+}
+
+void scan_bench_drop(void)
+{
+	bench.dropped++;
+}
+
+static void scan_bench_start(void)
+{
+	bench.start_cpu_ns = scan_bench_cpu_ns();
+}
+
+static void scan_bench_dump(void)
+{
+	uint64_t total_cpu_ns = scan_bench_cpu_ns() - bench.start_cpu_ns;
+	int64_t span_ms = bench.last_ms - bench.first_ms;
+	uint64_t reports = MAX(bench.reports, 1U);
+	uint64_t processed = MAX(bench.processed, 1U);
+
+	/* One line, machine readable */
+	printk("METRICS {\"scan_bench\": {\"reports\": %llu, \"bytes\": %llu, "
+	       "\"complete\": %llu, \"partial\": %llu, \"truncated\": %llu, \"dropped\": %llu, "
+	       "\"sim_span_ms\": %lld, \"reports_per_s\": %llu, "
+	       "\"complete_bytes_per_s\": %llu, "
+	       "\"cb_cpu_ns_per_report\": %llu, \"cb_copy_ns_per_report\": %llu, "
+	       "\"total_cpu_ns_per_report\": %llu}}\n",
+	       bench.reports, bench.bytes,
+	       bench.complete, bench.partial, bench.truncated, bench.dropped,
+	       span_ms, span_ms > 0 ? bench.reports * MSEC_PER_SEC / span_ms : 0,
+	       span_ms > 0 ? bench.complete_bytes * MSEC_PER_SEC / span_ms : 0,
+	       bench.cb_cpu_ns / processed, bench.cb_copy_ns / reports, total_cpu_ns / reports);
+}
+
+NATIVE_TASK(scan_bench_start, PRE_BOOT_2, 10);
+NATIVE_TASK(scan_bench_dump, ON_EXIT, 5);
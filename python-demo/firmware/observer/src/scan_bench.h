@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SCAN_BENCH_H_
+#define SCAN_BENCH_H_
+
+#include <stdint.h>
+
+/* Host CPU time consumed by this process, in nanoseconds */
+uint64_t scan_bench_cpu_ns(void);
+
+/* Account one scan report received, with the host CPU time the scan
+ * callback spent copying it into a batch (0 without batching)
+ */
+void scan_bench_record(uint8_t data_status, uint16_t data_len, uint64_t copy_ns);
+
+/* Host CPU time spent processing one report, wherever that runs */
+void scan_bench_processed(uint64_t cpu_ns);
+
+/* A report that could not be queued for processing */
+void scan_bench_drop(void);
+
+#endif /* SCAN_BENCH_H_ */
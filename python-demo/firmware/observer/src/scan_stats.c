@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/bluetooth/bluetooth.h>
+
+#if defined(CONFIG_ARCH_POSIX)
+#include "posix_native_task.h"
+#endif
+
+#include "fnv.h"
+#include "scan_stats.h"
+
+#define CAPACITY CONFIG_OBSERVER_SCAN_STATS_CAPACITY
+
+BUILD_ASSERT(IS_POWER_OF_TWO(CAPACITY), "Scan stats capacity must be a power of two");
+
+/* AD length histogram: [0..31] (fits a legacy PDU), then one bucket per power
+ * of two up to the 1650 bytes of a full extended advertising chain.
+ */
+#define LEN_BUCKETS 7
+
+struct scan_stats_entry {
+	bt_addr_le_t addr;
+	bool used;
+	uint8_t primary_phy;
+	uint8_t secondary_phy;
+	uint8_t sid;
+	int8_t rssi_min;
+	int8_t rssi_max;
+	int32_t rssi_sum;
+	uint32_t count;
+	uint32_t len_hist[LEN_BUCKETS];
+};
+
+static struct scan_stats_entry table[CAPACITY];
+static uint32_t tracked;
+static uint32_t untracked_reports;
+static struct k_spinlock lock;
+
+static uint8_t len_bucket(uint16_t len)
+{
+	if (len < 32U) {
+		return 0U;
+	}
+
+	/* 32..63 -> 1, 64..127 -> 2, ... */
+	return MIN(find_msb_set(len) - 5U, LEN_BUCKETS - 1U);
+}
+
+static struct scan_stats_entry *lookup(const bt_addr_le_t *addr)
+{
+	uint32_t i = fnv1a_32(FNV1A_32_INIT, addr, sizeof(*addr)) & (CAPACITY - 1U);
+
+	/* Linear probing. Entries are never removed so the first free slot
+	 * ends the probe sequence.
+	 */
+	for (uint32_t n = 0U; n < CAPACITY; n++) {
+		struct scan_stats_entry *e = &table[i];
+
+		if (!e->used) {
+			bt_addr_le_copy(&e->addr, addr);
+			e->used = true;
+			e->rssi_min = INT8_MAX;
+			e->rssi_max = INT8_MIN;
+			tracked++;
+			return e;
+		}
+
+		if (bt_addr_le_eq(&e->addr, addr)) {
+			return e;
+		}
+
+		i = (i + 1U) & (CAPACITY - 1U);
+	}
+
+	return NULL;
+}
+
+void scan_stats_record(const bt_addr_le_t *addr, int8_t rssi,
+		       uint8_t primary_phy, uint8_t secondary_phy,
+		       uint8_t sid, uint16_t data_len)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct scan_stats_entry *e = lookup(addr);
+
+	if (!e) {
+		untracked_reports++;
+		k_spin_unlock(&lock, key);
+		return;
+	}
+
+	e->count++;
+	e->rssi_sum += rssi;
+	e->rssi_min = MIN(e->rssi_min, rssi);
+	e->rssi_max = MAX(e->rssi_max, rssi);
+	e->primary_phy = primary_phy;
+	e->secondary_phy = secondary_phy;
+	e->sid = sid;
+	e->len_hist[len_bucket(data_len)]++;
+
+	k_spin_unlock(&lock, key);
+}
+
+void scan_stats_print(void)
+{
+	char addr[BT_ADDR_LE_STR_LEN];
+	struct scan_stats_entry e;
+	k_spinlock_key_t key;
+
+	printk("[SCAN STATS] %u advertisers, %u untracked reports\n",
+	       tracked, untracked_reports);
+	printk("[SCAN STATS] addr count rssi(min/avg/max) phy(pri/sec) sid "
+	       "len[<32,<64,<128,<256,<512,<1024,>=1024]\n");
+
+	for (size_t i = 0; i < ARRAY_SIZE(table); i++) {
+		/* Work on a copy, formatting is slow and the scan callbacks
+		 * shouldn't have to wait for it.
+		 */
+		key = k_spin_lock(&lock);
+		e = table[i];
+		k_spin_unlock(&lock, key);
+
+		if (!e.used || !e.count) {
+			continue;
+		}
+
+		bt_addr_le_to_str(&e.addr, addr, sizeof(addr));
+		printk("%s %u %d/%d/%d %u/%u %u %u,%u,%u,%u,%u,%u,%u\n",
+		       addr, e.count, e.rssi_min, (int)(e.rssi_sum / (int32_t)e.count),
+		       e.rssi_max, e.primary_phy, e.secondary_phy, e.sid,
+		       e.len_hist[0], e.len_hist[1], e.len_hist[2], e.len_hist[3],
+		       e.len_hist[4], e.len_hist[5], e.len_hist[6]);
+	}
+}
+
+#if CONFIG_OBSERVER_SCAN_STATS_PERIOD_S > 0
+static void print_work_handler(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+
+	scan_stats_print();
+	k_work_schedule(dwork, K_SECONDS(CONFIG_OBSERVER_SCAN_STATS_PERIOD_S));
+}
+
+static K_WORK_DELAYABLE_DEFINE(print_work, print_work_handler);
+
+static int scan_stats_init(void)
+{
+	k_work_schedule(&print_work, K_SECONDS(CONFIG_OBSERVER_SCAN_STATS_PERIOD_S));
+
+	return 0;
+}
+
+SYS_INIT(scan_stats_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+#endif /* CONFIG_OBSERVER_SCAN_STATS_PERIOD_S > 0 */
+
+#if defined(CONFIG_ARCH_POSIX)
+/* Last summary when the simulation ends */
+NATIVE_TASK(scan_stats_print, ON_EXIT, 10);
+#endif
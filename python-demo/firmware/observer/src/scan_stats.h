@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SCAN_STATS_H_
+#define SCAN_STATS_H_
+
+#include <stdint.h>
+#include <zephyr/bluetooth/addr.h>
+
+/* Account one advertising report to its advertiser. Cheap enough to be called
+ * for every report from the scan callbacks.
+ */
+void scan_stats_record(const bt_addr_le_t *addr, int8_t rssi,
+		       uint8_t primary_phy, uint8_t secondary_phy,
+		       uint8_t sid, uint16_t data_len);
+
+/* Print one summary line per tracked advertiser */
+void scan_stats_print(void);
+
+#endif /* SCAN_STATS_H_ */
@@ -0,0 +1,227 @@
+# Copyright (c) 2024 Nordic Semiconductor ASA
+# SPDX-License-Identifier: Apache-2.0
+
+"""Minimal HCI host over the H4 pipe pair of the hci_sim controller.
+
+Only what the demo scripts need: sending commands and waiting for their
+completion (one at a time or pipelined), waiting for events, and sending ISO
+data with controller flow control (Number Of Completed Packets).
+"""
+
+import struct
+
+H4_CMD = 0x01
+H4_ACL = 0x02
+H4_EVT = 0x04
+H4_ISO = 0x05
+
+EVT_CMD_COMPLETE = 0x0E
+EVT_CMD_STATUS = 0x0F
+EVT_NUM_COMPLETED_PACKETS = 0x13
+EVT_LE_META = 0x3E
+
+LE_ENH_CONN_COMPLETE = 0x0A
+LE_ENH_CONN_COMPLETE_V2 = 0x29
+LE_CIS_ESTABLISHED = 0x19
+LE_CREATE_BIG_COMPLETE = 0x1B
+
+# ISO data packet boundary flags
+ISO_PB_FIRST = 0b00
+ISO_PB_CONT = 0b01
+ISO_PB_COMPLETE = 0b10
+ISO_PB_LAST = 0b11
+
+
+class HciError(Exception):
+    def __init__(self, opcode, status):
+        super().__init__('command 0x%04x failed with status 0x%02x' % (opcode, status))
+        self.opcode = opcode
+        self.status = status
+
+
+def addr_bytes(addr: str) -> bytes:
+    """'C0:00:00:00:15:01' -> little endian bytes as used in HCI"""
+    return bytes.fromhex(addr.replace(':', ''))[::-1]
+
+
+def le24(value: int) -> bytes:
+    return value.to_bytes(3, 'little')
+
+
+class Hci:
+    def __init__(self, tx, rx):
+        self.tx = tx
+        self.rx = rx
+        # Num_HCI_Command_Packets, the host may assume 1 until told otherwise
+        self.cmd_credits = 1
+        # ISO flow control, set by read_buffer_size()
+        self.iso_len = 0
+        self.iso_credits = 0
+        self.iso_in_flight = {}
+        self.iso_completed = 0
+
+    def _read(self, n):
+        data = b''
+        while len(data) < n:
+            chunk = self.rx.read(n - len(data))
+            if not chunk:
+                raise EOFError('controller closed the pipe')
+            data += chunk
+        return data
+
+    def read_packet(self):
+        """Read one H4 packet, returns (type, payload without H4 header)"""
+        kind = self._read(1)[0]
+
+        if kind == H4_EVT:
+            hdr = self._read(2)
+            return kind, hdr + self._read(hdr[1])
+
+        if kind == H4_ACL:
+            hdr = self._read(4)
+            return kind, hdr + self._read(struct.unpack('<H', hdr[2:])[0])
+
+        if kind == H4_ISO:
+            hdr = self._read(4)
+            return kind, hdr + self._read(struct.unpack('<H', hdr[2:])[0] & 0x3FFF)
+
+        raise ValueError('unknown H4 packet type 0x%02x' % kind)
+
+    def _handle(self, kind, payload):
+        """Book-keeping done for every packet, whoever waits for it"""
+        if kind == H4_EVT and payload[0] in (EVT_CMD_COMPLETE, EVT_CMD_STATUS):
+            self.cmd_credits = payload[2 if payload[0] == EVT_CMD_COMPLETE else 3]
+
+        if kind == H4_EVT and payload[0] == EVT_NUM_COMPLETED_PACKETS:
+            count = payload[2]
+            for i in range(count):
+                handle, completed = struct.unpack_from('<HH', payload, 3 + 4 * i)
+                if handle in self.iso_in_flight:
+                    self.iso_in_flight[handle] -= completed
+                    self.iso_credits += completed
+                    self.iso_completed += completed
+
+    def poll(self):
+        kind, payload = self.read_packet()
+        self._handle(kind, payload)
+        return kind, payload
+
+    def wait_event(self, match):
+        """Read packets until `match(code, params)` returns something"""
+        while True:
+            kind, payload = self.poll()
+            if kind != H4_EVT:
+                continue
+            result = match(payload[0], payload[2:])
+            if result is not None:
+                return result
+
+    def wait_le_event(self, subevent):
+        def match(code, params):
+            if code == EVT_LE_META and params[0] == subevent:
+                return params[1:]
+            return None
+
+        return self.wait_event(match)
+
+    def send_cmd(self, opcode, params=b''):
+        self.tx.write(struct.pack('<BHB', H4_CMD, opcode, len(params)) + params)
+        self.cmd_credits -= 1
+
+    def cmd(self, opcode, params=b''):
+        """Send a command and wait for it to complete.
+
+        Returns the return parameters after the status for Command Complete,
+        or b'' for Command Status. Raises HciError on a non-zero status.
+        """
+        self.send_cmd(opcode, params)
+
+        def match(code, params):
+            if code == EVT_CMD_COMPLETE and struct.unpack_from('<H', params, 1)[0] == opcode:
+                return params[3:]
+            if code == EVT_CMD_STATUS and struct.unpack_from('<H', params, 2)[0] == opcode:
+                return params[:1]
+            return None
+
+        ret = self.wait_event(match)
+        # Both carry the status in the first byte we return
+        if ret and ret[0]:
+            raise HciError(opcode, ret[0])
+        return ret[1:]
+
+    def cmds(self, commands, window=None):
+        """Send (opcode, params) commands back to back and wait for them all.
+
+        At most `window` commands are outstanding, or as many as the
+        controller allows (Num_HCI_Command_Packets) if None. A larger window is
+        safe with hci_uart_async: it only takes a command out of the pipe once
+        it has a buffer for it, the pipe holds the rest. Raises HciError for
+        the first command that failed, after all of them completed.
+        """
+        error = None
+        outstanding = 0
+
+        def can_send():
+            if window:
+                return outstanding < window
+            return self.cmd_credits > 0 or not outstanding
+
+        def complete():
+            nonlocal error
+            kind, payload = self.poll()
+            if kind != H4_EVT or payload[0] not in (EVT_CMD_COMPLETE, EVT_CMD_STATUS):
+                return 0
+
+            if payload[0] == EVT_CMD_COMPLETE:
+                opcode, status = struct.unpack_from('<HB', payload, 3)
+            else:
+                status, _, opcode = struct.unpack_from('<BBH', payload, 2)
+
+            if status and error is None:
+                error = HciError(opcode, status)
+            return 1
+
+        for opcode, params in commands:
+            while not can_send():
+                outstanding -= complete()
+            self.send_cmd(opcode, params)
+            outstanding += 1
+
+        while outstanding:
+            outstanding -= complete()
+
+        if error:
+            raise error
+
+    def read_buffer_size(self):
+        """LE Read Buffer Size v2: sets up ISO flow control"""
+        ret = self.cmd(0x2060)
+        _, _, self.iso_len, self.iso_credits = struct.unpack('<HBHB', ret)
+        return self.iso_len, self.iso_credits
+
+    def iso_fragments(self, sdu_len):
+        # The first fragment carries the 4 byte SDU header
+        return max(1, -(-(sdu_len + 4) // self.iso_len))
+
+    def send_iso(self, handle, seq, sdu):
+        """Send one SDU, fragmented to the controller's buffer size.
+
+        The caller must make sure there are iso_fragments(len(sdu)) credits.
+        """
+        data = struct.pack('<HH', seq & 0xFFFF, len(sdu)) + sdu
+        pos = 0
+
+        while pos < len(data):
+            chunk = data[pos:pos + self.iso_len]
+            last = pos + len(chunk) == len(data)
+
+            if pos == 0:
+                pb = ISO_PB_COMPLETE if last else ISO_PB_FIRST
+            else:
+                pb = ISO_PB_LAST if last else ISO_PB_CONT
+
+            self.tx.write(struct.pack('<BHH', H4_ISO, handle | (pb << 12), len(chunk)) + chunk)
+            pos += len(chunk)
+
+            self.iso_credits -= 1
+            self.iso_in_flight[handle] = self.iso_in_flight.get(handle, 0) + 1
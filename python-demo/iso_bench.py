@@ -0,0 +1,288 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 Nordic Semiconductor ASA
+# SPDX-License-Identifier: Apache-2.0
+
+"""ISO stream benchmark over the host pipe.
+
+This script is the host of the hci_sim controller. It connects to
+firmware/iso_peer and sets up a CIS to it, and creates a BIG that iso_peer
+syncs to. It then streams `--count` SDUs on each stream, as fast as the
+controller's ISO buffers allow (one SDU per SDU interval once they are full).
+
+Each SDU starts with its sequence number and the SDU interval. iso_peer uses
+them to measure delay variation, jitter, lost and late SDUs in simulated time,
+and prints them as METRICS on exit. The result, one JSON object, combines
+those with the transport latencies reported by the controller and is appended
+to the output file (JSON lines).
+
+The simulation is throttled by the handbrake (`--realtime`, 1 = real time) so
+the python host has to keep up like it would with a real radio.
+
+Example:
+    ./iso_bench.py --sdu-interval 10000 --sdu-len 120 --count 1000 -o iso_bench.jsonl
+"""
+
+import argparse
+import json
+import os
+import struct
+import subprocess
+import sys
+import time
+
+import hci
+from hci import addr_bytes, le24
+from scan_bench import FW_DIR, build, parse_metrics
+
+# iso_peer's identity, see its main.c
+PEER_ADDR = 'C0:00:00:00:15:01'
+OWN_ADDR = 'C1:23:45:67:89:0A'
+BROADCASTER_NAME = b'iso_bench'
+
+PHY_2M = 0x02
+SDU_HDR_LEN = 8
+
+
+def le16(value):
+    return struct.pack('<H', value)
+
+
+def setup_controller(h):
+    h.cmd(0x0C03)
+    h.cmd(0x0C01, b'\xff' * 8)
+    h.cmd(0x2001, b'\xff' * 8)
+    # LE Set Host Feature: Connected Isochronous Stream (Host Support)
+    h.cmd(0x2074, bytes([32, 1]))
+    h.cmd(0x2005, addr_bytes(OWN_ADDR))
+    return h.read_buffer_size()
+
+
+def connect(h, args):
+    conn_interval = max(6, args.sdu_interval // 1250)
+
+    params = bytes([0x00, 0x01, 0x01]) + addr_bytes(PEER_ADDR) + bytes([0x01])
+    params += le16(0x0060) + le16(0x0060)
+    params += le16(conn_interval) + le16(conn_interval)
+    params += le16(0) + le16(100) + le16(0) + le16(0)
+    h.cmd(0x2043, params)
+
+    def match(code, p):
+        if code == hci.EVT_LE_META and p[0] in (hci.LE_ENH_CONN_COMPLETE,
+                                                hci.LE_ENH_CONN_COMPLETE_V2):
+            return p[1:]
+        return None
+
+    evt = h.wait_event(match)
+    if evt[0]:
+        raise RuntimeError('connection failed (status 0x%02x)' % evt[0])
+
+    return struct.unpack_from('<H', evt, 1)[0]
+
+
+def setup_data_path(h, handle):
+    # Host to controller, over HCI, transparent codec
+    h.cmd(0x206E, le16(handle) + bytes([0x00, 0x00, 0x03, 0, 0, 0, 0]) + le24(0) + b'\x00')
+
+
+def setup_cis(h, args):
+    acl = connect(h, args)
+
+    params = bytes([0x00]) + le24(args.sdu_interval) + le24(args.sdu_interval)
+    params += bytes([0x00, 0x00, 0x00])
+    params += le16(args.max_latency) + le16(args.max_latency)
+    params += bytes([0x01, 0x00]) + le16(args.sdu_len) + le16(0)
+    params += bytes([PHY_2M, PHY_2M, args.rtn, args.rtn])
+    ret = h.cmd(0x2062, params)
+    cis = struct.unpack_from('<H', ret, 2)[0]
+
+    h.cmd(0x2064, bytes([0x01]) + le16(cis) + le16(acl))
+
+    evt = h.wait_le_event(hci.LE_CIS_ESTABLISHED)
+    if evt[0]:
+        raise RuntimeError('CIS failed (status 0x%02x)' % evt[0])
+
+    setup_data_path(h, cis)
+
+    return cis, {
+        'transport_latency_us': int.from_bytes(evt[9:12], 'little'),
+        'nse': evt[17],
+        'bn': evt[18],
+        'ft': evt[20],
+        'iso_interval_us': struct.unpack_from('<H', evt, 26)[0] * 1250,
+    }
+
+
+def setup_bis(h, args):
+    name = bytes([len(BROADCASTER_NAME) + 1, 0x09]) + BROADCASTER_NAME
+
+    h.cmd(0x2035, b'\x00' + addr_bytes(OWN_ADDR))
+    params = b'\x00' + le16(0x0000) + le24(0x00A0) + le24(0x00A0)
+    params += bytes([0x07, 0x01, 0x00]) + bytes(6)
+    params += bytes([0x00, 0x7F, 0x01, 0x00, 0x01, 0x00, 0x00])
+    h.cmd(0x2036, params)
+    h.cmd(0x2037, bytes([0x00, 0x03, 0x01, len(name)]) + name)
+    h.cmd(0x203E, b'\x00' + le16(0x0050) + le16(0x0050) + le16(0))
+    h.cmd(0x2040, bytes([0x01, 0x00]))
+    h.cmd(0x2039, bytes([0x01, 0x01, 0x00]) + le16(0) + b'\x00')
+
+    params = bytes([0x00, 0x00, 0x01]) + le24(args.sdu_interval)
+    params += le16(args.sdu_len) + le16(args.max_latency)
+    params += bytes([args.rtn, PHY_2M, 0x00, 0x00, 0x00]) + bytes(16)
+    h.cmd(0x2068, params)
+
+    evt = h.wait_le_event(hci.LE_CREATE_BIG_COMPLETE)
+    if evt[0]:
+        raise RuntimeError('BIG failed (status 0x%02x)' % evt[0])
+
+    bis = struct.unpack_from('<H', evt, 18)[0]
+    setup_data_path(h, bis)
+
+    return bis, {
+        'transport_latency_us': int.from_bytes(evt[5:8], 'little'),
+        'nse': evt[9],
+        'bn': evt[10],
+        'irc': evt[12],
+        'iso_interval_us': struct.unpack_from('<H', evt, 15)[0] * 1250,
+    }
+
+
+def stream(h, handles, args):
+    """Send `count` SDUs on every handle, as fast as credits come back"""
+    seq = dict.fromkeys(handles, 0)
+    fragments = h.iso_fragments(args.sdu_len)
+    padding = bytes(args.sdu_len - SDU_HDR_LEN)
+
+    while any(s < args.count for s in seq.values()):
+        sent = False
+
+        for handle in handles:
+            if seq[handle] < args.count and h.iso_credits >= fragments:
+                sdu = struct.pack('<II', seq[handle], args.sdu_interval) + padding
+                h.send_iso(handle, seq[handle], sdu)
+                seq[handle] += 1
+                sent = True
+
+        if not sent:
+            h.poll()
+
+    # Let the last ones go out
+    while any(h.iso_in_flight.values()):
+        h.poll()
+
+    return seq
+
+
+def run_host(h, args, result):
+    iso_len, iso_count = setup_controller(h)
+    result['iso_buffers'] = {'len': iso_len, 'count': iso_count}
+
+    handles = []
+    if 'cis' in args.streams:
+        handle, result['cis'] = setup_cis(h, args)
+        handles.append(handle)
+    if 'bis' in args.streams:
+        handle, result['bis'] = setup_bis(h, args)
+        handles.append(handle)
+
+    print('Streaming %d SDUs on %s' % (args.count, ', '.join(args.streams)), file=sys.stderr)
+    start = time.monotonic()
+    sent = stream(h, handles, args)
+    result['stream_wall_s'] = time.monotonic() - start
+
+    for name, handle in zip(args.streams, handles):
+        result[name]['sent'] = sent[handle]
+
+
+def main():
+    parser = argparse.ArgumentParser(description='ISO stream benchmark over the host pipe')
+    parser.add_argument('--sdu-interval', type=int, default=10000,
+                        help='SDU interval in us (default: %(default)s)')
+    parser.add_argument('--sdu-len', type=int, default=120,
+                        help='SDU size in bytes (default: %(default)s)')
+    parser.add_argument('--count', type=int, default=500,
+                        help='SDUs to send on each stream (default: %(default)s)')
+    parser.add_argument('--rtn', type=int, default=2,
+                        help='retransmissions (default: %(default)s)')
+    parser.add_argument('--max-latency', type=int, default=20,
+                        help='max transport latency in ms (default: %(default)s)')
+    parser.add_argument('--streams', default='cis,bis',
+                        help='comma separated, from cis and bis (default: %(default)s)')
+    parser.add_argument('--realtime', type=float, default=1,
+                        help='handbrake real-time factor, 0 to run unthrottled '
+                             '(default: %(default)s)')
+    parser.add_argument('--sim-length', type=float,
+                        help='simulated seconds (default: enough for --count SDUs)')
+    parser.add_argument('--sim-id', default='iso-bench')
+    parser.add_argument('--seed', type=int, default=70)
+    parser.add_argument('--no-build', action='store_true')
+    parser.add_argument('-o', '--output', default='iso_bench.jsonl')
+    args = parser.parse_args()
+
+    args.streams = [s for s in ('cis', 'bis') if s in args.streams.split(',')]
+    args.sdu_len = max(args.sdu_len, SDU_HDR_LEN)
+    if args.sim_length is None:
+        args.sim_length = 3 + 2 * args.count * args.sdu_interval / 1e6
+
+    if args.no_build:
+        controller = os.path.join(FW_DIR, 'hci_sim', 'build', 'zephyr', 'zephyr.exe')
+        peer = os.path.join(FW_DIR, 'iso_peer', 'build', 'zephyr', 'zephyr.exe')
+    else:
+        controller = build('hci_sim', 'build')
+        peer = build('iso_peer', 'build')
+
+    fifo_dir = os.path.join('/tmp/py', args.sim_id)
+    uart_h2c = os.path.join(fifo_dir, 'uart.h2c')
+    uart_c2h = os.path.join(fifo_dir, 'uart.c2h')
+    os.makedirs(fifo_dir, exist_ok=True)
+    for fifo in (uart_h2c, uart_c2h):
+        if not os.path.exists(fifo):
+            os.mkfifo(fifo)
+
+    sim = ['-s=' + args.sim_id, '-rs=%d' % args.seed, '-RealEncryption=0']
+    devices = 3 if args.realtime else 2
+    bsim_bin = os.path.join(os.environ['BSIM_OUT_PATH'], 'bin')
+
+    procs = [
+        subprocess.Popen(['./bs_2G4_phy_v1', '-s=' + args.sim_id, '-D=%d' % devices,
+                          '-sim_length=%d' % int(args.sim_length * 1e6)],
+                         cwd=bsim_bin, stdout=subprocess.DEVNULL),
+        subprocess.Popen([controller, '-d=0', *sim,
+                          '-fifo_0_rx=' + uart_h2c, '-fifo_0_tx=' + uart_c2h],
+                         stdout=subprocess.DEVNULL),
+    ]
+    peer_proc = subprocess.Popen([peer, '-d=1', *sim], stdout=subprocess.PIPE, text=True)
+
+    if args.realtime:
+        procs.append(subprocess.Popen(['./bs_device_handbrake', '-s=' + args.sim_id, '-d=2',
+                                       '-r=%g' % args.realtime],
+                                      cwd=os.path.join(os.environ['BSIM_COMPONENTS_PATH'],
+                                                       'device_handbrake')))
+
+    result = {
+        'sdu_interval_us': args.sdu_interval,
+        'sdu_len': args.sdu_len,
+        'count': args.count,
+        'rtn': args.rtn,
+        'max_latency_ms': args.max_latency,
+        'realtime': args.realtime,
+    }
+
+    start = time.monotonic()
+    try:
+        with open(uart_h2c, 'wb', buffering=0) as tx, open(uart_c2h, 'rb', buffering=0) as rx:
+            run_host(hci.Hci(tx, rx), args, result)
+    except EOFError:
+        result['error'] = 'simulation ended before all SDUs were sent'
+    result['wall_s'] = time.monotonic() - start
+
+    output, _ = peer_proc.communicate()
+    result['exit_status'] = [peer_proc.returncode] + [p.wait() for p in procs]
+    result.update(parse_metrics(output))
+
+    with open(args.output, 'a') as out:
+        out.write(json.dumps(result) + '\n')
+    print(json.dumps(result))
+
+
+if __name__ == '__main__':
+    main()
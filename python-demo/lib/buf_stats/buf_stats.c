@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * net_buf pool usage statistics.
+ *
+ * The net_buf allocation entry points are wrapped at link time (see
+ * CMakeLists.txt), so every allocation made from outside of net_buf itself
+ * is accounted to its pool. The time spent in the allocation is measured in
+ * simulated time: any time passing means the caller had to wait for a buffer
+ * to be freed.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/buf.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/iterable_sections.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "posix_native_task.h"
+
+struct pool_stats {
+	atomic_t allocs;
+	atomic_t waits;
+	atomic_t failures;
+	atomic_t blocked_ticks;
+	atomic_t in_use_max;
+};
+
+static struct pool_stats stats[CONFIG_BUF_STATS_MAX_POOLS];
+
+struct net_buf *__real_net_buf_alloc_fixed(struct net_buf_pool *pool, k_timeout_t timeout);
+struct net_buf *__real_net_buf_alloc_len(struct net_buf_pool *pool, size_t size,
+					 k_timeout_t timeout);
+struct net_buf *__real_net_buf_alloc_with_data(struct net_buf_pool *pool, void *data,
+					       size_t size, k_timeout_t timeout);
+
+static void atomic_max(atomic_t *target, atomic_val_t value)
+{
+	atomic_val_t old = atomic_get(target);
+
+	while (value > old && !atomic_cas(target, old, value)) {
+		old = atomic_get(target);
+	}
+}
+
+static struct net_buf *account(struct net_buf_pool *pool, struct net_buf *buf,
+			       int64_t start_ticks)
+{
+	int64_t waited = k_uptime_ticks() - start_ticks;
+	int id = net_buf_pool_get_id(pool);
+	struct pool_stats *s;
+
+	if (id < 0 || (size_t)id >= ARRAY_SIZE(stats)) {
+		return buf;
+	}
+
+	s = &stats[id];
+
+	atomic_inc(&s->allocs);
+
+	if (waited > 0) {
+		atomic_inc(&s->waits);
+		atomic_add(&s->blocked_ticks, (atomic_val_t)waited);
+	}
+
+	if (!buf) {
+		atomic_inc(&s->failures);
+		return NULL;
+	}
+
+	/* The pool is at its fullest right after an allocation */
+	atomic_max(&s->in_use_max, pool->buf_count - atomic_get(&pool->avail_count));
+
+	return buf;
+}
+
+struct net_buf *__wrap_net_buf_alloc_fixed(struct net_buf_pool *pool, k_timeout_t timeout)
+{
+	int64_t start = k_uptime_ticks();
+
+	return account(pool, __real_net_buf_alloc_fixed(pool, timeout), start);
+}
+
+struct net_buf *__wrap_net_buf_alloc_len(struct net_buf_pool *pool, size_t size,
+					 k_timeout_t timeout)
+{
+	int64_t start = k_uptime_ticks();
+
+	return account(pool, __real_net_buf_alloc_len(pool, size, timeout), start);
+}
+
+struct net_buf *__wrap_net_buf_alloc_with_data(struct net_buf_pool *pool, void *data,
+					       size_t size, k_timeout_t timeout)
+{
+	int64_t start = k_uptime_ticks();
+
+	return account(pool, __real_net_buf_alloc_with_data(pool, data, size, timeout), start);
+}
+
+static void buf_stats_print(void)
+{
+	bool first = true;
+
+	printk("[BUF STATS] pool: used_max/count allocs waits failures blocked_us\n");
+
+	STRUCT_SECTION_FOREACH(net_buf_pool, pool) {
+		int id = net_buf_pool_get_id(pool);
+		struct pool_stats *s;
+
+		if ((size_t)id >= ARRAY_SIZE(stats)) {
+			break;
+		}
+
+		s = &stats[id];
+
+		printk("[BUF STATS] %s: %ld/%u %ld %ld %ld %llu%s\n", pool->name,
+		       atomic_get(&s->in_use_max), pool->buf_count, atomic_get(&s->allocs),
+		       atomic_get(&s->waits), atomic_get(&s->failures),
+		       k_ticks_to_us_floor64(atomic_get(&s->blocked_ticks)),
+		       atomic_get(&s->allocs) ? "" : " (unused)");
+	}
+
+	printk("METRICS {\"buf_pools\": [");
+
+	STRUCT_SECTION_FOREACH(net_buf_pool, pool) {
+		int id = net_buf_pool_get_id(pool);
+		struct pool_stats *s;
+
+		if ((size_t)id >= ARRAY_SIZE(stats)) {
+			break;
+		}
+
+		s = &stats[id];
+
+		printk("%s{\"name\": \"%s\", \"count\": %u, \"used_max\": %ld, \"allocs\": %ld, "
+		       "\"waits\": %ld, \"failures\": %ld, \"blocked_us\": %llu}",
+		       first ? "" : ", ", pool->name, pool->buf_count,
+		       atomic_get(&s->in_use_max), atomic_get(&s->allocs),
+		       atomic_get(&s->waits), atomic_get(&s->failures),
+		       k_ticks_to_us_floor64(atomic_get(&s->blocked_ticks)));
+		first = false;
+	}
+
+	printk("]}\n");
+}
+
+NATIVE_TASK(buf_stats_print, ON_EXIT, 10);
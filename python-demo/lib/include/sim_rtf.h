@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SIM_RTF_H_
+#define SIM_RTF_H_
+
+#include <stdint.h>
+
+/* Account host time spent in pipe I/O (e.g. uart_posix_pipe) to the
+ * real-time factor report:
+ *
+ *	uint64_t start = sim_rtf_io_begin();
+ *	ret = read(...);
+ *	sim_rtf_io_end(start);
+ *
+ * Both compile to nothing without CONFIG_SIM_RTF.
+ */
+#if defined(CONFIG_SIM_RTF)
+uint64_t sim_rtf_io_begin(void);
+void sim_rtf_io_end(uint64_t start);
+#else
+static inline uint64_t sim_rtf_io_begin(void)
+{
+	return 0;
+}
+
+static inline void sim_rtf_io_end(uint64_t start)
+{
+	(void)start;
+}
+#endif
+
+#endif /* SIM_RTF_H_ */
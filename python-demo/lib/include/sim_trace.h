@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SIM_TRACE_H_
+#define SIM_TRACE_H_
+
+#include <stdint.h>
+
+/* Simulated-time tracepoints, see python-demo/lib/sim_trace.
+ *
+ * `name` must be a string literal: its address is the event id, the string
+ * is only looked at when the trace is written out. BEGIN/END pairs with the
+ * same name make one span, they don't have to nest with other names. The
+ * two arguments are free-form.
+ *
+ * All of them compile to nothing without CONFIG_SIM_TRACE.
+ */
+#if defined(CONFIG_SIM_TRACE)
+void sim_trace_record(const char *name, char phase, uint32_t arg0, uint32_t arg1);
+
+#define SIM_TRACE_BEGIN(name, arg0, arg1)   sim_trace_record(name, 'b', arg0, arg1)
+#define SIM_TRACE_END(name, arg0, arg1)     sim_trace_record(name, 'e', arg0, arg1)
+#define SIM_TRACE_INSTANT(name, arg0, arg1) sim_trace_record(name, 'i', arg0, arg1)
+#else
+#define SIM_TRACE_BEGIN(name, arg0, arg1)   do { } while (0)
+#define SIM_TRACE_END(name, arg0, arg1)     do { } while (0)
+#define SIM_TRACE_INSTANT(name, arg0, arg1) do { } while (0)
+#endif
+
+#endif /* SIM_TRACE_H_ */
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Real-time factor and stall attribution.
+ *
+ * Simulated time only advances while the PHY lets this device run, and the
+ * device only asks for more once its CPU work is done. So over an interval of
+ * simulated time, the host (wall-clock) time splits into:
+ * - CPU time of this process: the device's own work, of which pipe I/O is a
+ *   part (non-blocking syscalls)
+ * - the rest, blocked: waiting for the PHY, i.e. for the other devices, an
+ *   external host keeping its controller busy, or the handbrake. Being
+ *   descheduled by an overloaded host also lands here.
+ */
+
+#include <time.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "posix_native_task.h"
+
+#include "sim_rtf.h"
+
+struct sample {
+	int64_t sim_us;
+	uint64_t wall_ns;
+	uint64_t cpu_ns;
+	uint64_t pipe_ns;
+};
+
+static struct k_spinlock lock;
+static uint64_t pipe_ns;
+
+static struct sample boot;
+static struct sample last;
+/* Lowest real-time factor of a report period, x100 */
+static uint64_t worst_rtf = UINT64_MAX;
+
+static uint64_t clock_ns(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+
+	return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+uint64_t sim_rtf_io_begin(void)
+{
+	return clock_ns(CLOCK_MONOTONIC);
+}
+
+void sim_rtf_io_end(uint64_t start)
+{
+	uint64_t ns = clock_ns(CLOCK_MONOTONIC) - start;
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	pipe_ns += ns;
+
+	k_spin_unlock(&lock, key);
+}
+
+static void sample_take(struct sample *s)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	s->pipe_ns = pipe_ns;
+
+	k_spin_unlock(&lock, key);
+
+	s->sim_us = (int64_t)k_ticks_to_us_floor64(k_uptime_ticks());
+	s->wall_ns = clock_ns(CLOCK_MONOTONIC);
+	s->cpu_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+struct split {
+	uint64_t sim_ms;
+	uint64_t wall_ms;
+	/* x100 */
+	uint64_t rtf;
+	uint64_t work_ms;
+	uint64_t pipe_ms;
+	uint64_t wait_ms;
+};
+
+static void split_get(const struct sample *from, const struct sample *to, struct split *out)
+{
+	uint64_t wall = to->wall_ns - from->wall_ns;
+	uint64_t cpu = to->cpu_ns - from->cpu_ns;
+	uint64_t pipe = MIN(to->pipe_ns - from->pipe_ns, cpu);
+
+	out->sim_ms = (to->sim_us - from->sim_us) / USEC_PER_MSEC;
+	out->wall_ms = wall / NSEC_PER_MSEC;
+	out->rtf = wall ? (uint64_t)(to->sim_us - from->sim_us) * NSEC_PER_USEC * 100U / wall : 0;
+	out->pipe_ms = pipe / NSEC_PER_MSEC;
+	out->work_ms = (cpu - pipe) / NSEC_PER_MSEC;
+	out->wait_ms = wall > cpu ? (wall - cpu) / NSEC_PER_MSEC : 0;
+}
+
+static unsigned int percent(uint64_t part, uint64_t total)
+{
+	return total ? (unsigned int)(part * 100U / total) : 0U;
+}
+
+static void report_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(report_work, report_work_handler);
+
+static void report_work_handler(struct k_work *work)
+{
+	struct sample now;
+	struct split s;
+
+	sample_take(&now);
+	split_get(&last, &now, &s);
+	last = now;
+
+	worst_rtf = MIN(worst_rtf, s.rtf);
+
+	printk("[RTF] sim %llu ms in %llu ms: x%llu.%02llu, work %u%% pipe %u%% blocked %u%%\n",
+	       s.sim_ms, s.wall_ms, s.rtf / 100U, s.rtf % 100U,
+	       percent(s.work_ms, s.wall_ms), percent(s.pipe_ms, s.wall_ms),
+	       percent(s.wait_ms, s.wall_ms));
+
+	k_work_schedule(&report_work, K_MSEC(CONFIG_SIM_RTF_PERIOD_MS));
+}
+
+static void sim_rtf_print(void)
+{
+	struct sample now;
+	struct split s;
+	uint64_t worst;
+
+	sample_take(&now);
+	split_get(&boot, &now, &s);
+
+	/* No full report period yet: the whole run is the worst one */
+	worst = MIN(worst_rtf, s.rtf);
+
+	printk("METRICS {\"sim_rtf\": {\"sim_ms\": %llu, \"wall_ms\": %llu, \"rtf\": %llu.%02llu, "
+	       "\"worst_rtf\": %llu.%02llu, \"work_ms\": %llu, \"pipe_ms\": %llu, "
+	       "\"blocked_ms\": %llu}}\n",
+	       s.sim_ms, s.wall_ms, s.rtf / 100U, s.rtf % 100U, worst / 100U, worst % 100U,
+	       s.work_ms, s.pipe_ms, s.wait_ms);
+}
+
+static void sim_rtf_start(void)
+{
+	/* Before the kernel runs: simulated time and pipe I/O are still 0 */
+	boot.wall_ns = clock_ns(CLOCK_MONOTONIC);
+	boot.cpu_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+	last = boot;
+}
+
+static int sim_rtf_init(void)
+{
+	if (CONFIG_SIM_RTF_PERIOD_MS) {
+		k_work_schedule(&report_work, K_MSEC(CONFIG_SIM_RTF_PERIOD_MS));
+	}
+
+	return 0;
+}
+
+SYS_INIT(sim_rtf_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+NATIVE_TASK(sim_rtf_start, PRE_BOOT_2, 10);
+NATIVE_TASK(sim_rtf_print, ON_EXIT, 10);
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Simulated-time tracepoints.
+ *
+ * Records go to a ring buffer allocated up front: recording one is a few
+ * stores under a spinlock, with no I/O and no allocation, so tracing doesn't
+ * change the timing it is looking at. Once the ring is full the oldest
+ * records are overwritten and counted as dropped.
+ *
+ * On exit the ring is written to the -trace=<file> as CSV:
+ *   # sim_trace
+ *   # dropped <n>
+ *   <sim_us>,<b|e|i>,<name>,<arg0>,<arg1>
+ */
+
+#include <stdio.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/printk.h>
+
+#include "cmdline.h" /* native_posix command line options header */
+#include "posix_native_task.h"
+
+#include "sim_trace.h"
+
+struct record {
+	int64_t sim_us;
+	const char *name;
+	uint32_t arg0;
+	uint32_t arg1;
+	char phase;
+};
+
+static struct k_spinlock lock;
+static struct record ring[CONFIG_SIM_TRACE_ENTRIES];
+/* Total number of records, the next one goes to ring[count % size] */
+static uint64_t count;
+
+static char *trace_path;
+
+void sim_trace_record(const char *name, char phase, uint32_t arg0, uint32_t arg1)
+{
+	int64_t sim_us = (int64_t)k_ticks_to_us_floor64(k_uptime_ticks());
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct record *r = &ring[count % ARRAY_SIZE(ring)];
+
+	r->sim_us = sim_us;
+	r->name = name;
+	r->arg0 = arg0;
+	r->arg1 = arg1;
+	r->phase = phase;
+	count++;
+
+	k_spin_unlock(&lock, key);
+}
+
+static void sim_trace_cmdline_opts(void)
+{
+	static struct args_struct_t trace_opts[] = {
+		{
+			.option = "trace",
+			.name = "path",
+			.type = 's',
+			.dest = (void *)&trace_path,
+			.descript = "Write the simulated-time trace (CSV) to this file on exit",
+		},
+		ARG_TABLE_ENDMARKER
+	};
+
+	native_add_command_line_opts(trace_opts);
+}
+
+static void sim_trace_write(void)
+{
+	uint64_t first;
+	FILE *f;
+
+	if (!trace_path) {
+		return;
+	}
+
+	f = fopen(trace_path, "w");
+	if (!f) {
+		printk("[TRACE] can't open %s\n", trace_path);
+		return;
+	}
+
+	/* Everything else has stopped by now, no need to lock */
+	first = count > ARRAY_SIZE(ring) ? count - ARRAY_SIZE(ring) : 0;
+
+	fprintf(f, "# sim_trace\n# dropped %llu\n", (unsigned long long)first);
+
+	for (uint64_t i = first; i < count; i++) {
+		const struct record *r = &ring[i % ARRAY_SIZE(ring)];
+
+		fprintf(f, "%lld,%c,%s,%u,%u\n", (long long)r->sim_us, r->phase, r->name,
+			r->arg0, r->arg1);
+	}
+
+	fclose(f);
+
+	printk("METRICS {\"sim_trace\": {\"records\": %llu, \"dropped\": %llu}}\n",
+	       (unsigned long long)(count - first), (unsigned long long)first);
+}
+
+NATIVE_TASK(sim_trace_cmdline_opts, PRE_BOOT_1, 10);
+NATIVE_TASK(sim_trace_write, ON_EXIT, 10);
@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Per-thread CPU time, context switches and ready time.
+ *
+ * The kernel calls the tracing user hooks around every context switch and
+ * interrupt. Between two hooks, exactly one thread (or interrupt) is running
+ * on the simulated CPU, so the process CPU time that went by is charged to
+ * it. Code runs in zero simulated time, which is why host CPU time is used:
+ * it's what the device's work actually costs, and what slows the simulation
+ * down.
+ *
+ * A thread switched out while still in the run queue was preempted (or
+ * yielded): until it is switched back in, the time goes to its ready time.
+ * Threads woken up while another one runs are not tracked until then.
+ *
+ * The totals are sampled periodically in simulated time, and printed as a
+ * time series on exit.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/kernel_structs.h>
+#include <zephyr/init.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/tracing/tracing.h>
+
+#include "posix_native_task.h"
+
+#define NUM_ENTRIES (CONFIG_THREAD_STATS_MAX_THREADS + 1)
+/* Interrupts, whichever thread they interrupted */
+#define ISR_ENTRY 0
+
+struct counters {
+	uint64_t cpu_ns;
+	uint64_t ready_ns;
+	uint32_t switches;
+};
+
+struct entry {
+	const struct k_thread *thread;
+	char name[CONFIG_THREAD_MAX_NAME_LEN];
+	struct counters total;
+	bool ready;
+	/* Ready time is accounted up to this point */
+	uint64_t ready_since_ns;
+};
+
+static struct k_spinlock lock;
+
+static struct entry entries[NUM_ENTRIES] = {
+	[ISR_ENTRY] = {.name = "isr"},
+};
+static size_t entry_count = 1;
+
+/* Running thread or interrupt, its CPU time is accounted up to running_since */
+static struct entry *running;
+static uint64_t running_since_ns;
+static struct entry *interrupted;
+static unsigned int isr_depth;
+
+static struct counters samples[CONFIG_THREAD_STATS_SAMPLES][NUM_ENTRIES];
+static int64_t sample_ms[CONFIG_THREAD_STATS_SAMPLES];
+static size_t sample_count;
+
+static uint64_t cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+	return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static struct entry *entry_get(const struct k_thread *thread)
+{
+	struct entry *e = NULL;
+
+	for (size_t i = ISR_ENTRY + 1; i < entry_count; i++) {
+		if (entries[i].thread == thread) {
+			e = &entries[i];
+			break;
+		}
+	}
+
+	if (!e) {
+		if (entry_count == ARRAY_SIZE(entries)) {
+			return NULL;
+		}
+
+		e = &entries[entry_count++];
+		e->thread = thread;
+	}
+
+	/* Threads can be named after they're started */
+	if (!e->name[0]) {
+		const char *name = k_thread_name_get((k_tid_t)thread);
+
+		if (name && name[0]) {
+			strncpy(e->name, name, sizeof(e->name) - 1);
+		}
+	}
+
+	return e;
+}
+
+/* Account everything up to now, called with the lock held */
+static void flush(uint64_t now)
+{
+	if (running) {
+		running->total.cpu_ns += now - running_since_ns;
+	}
+	running_since_ns = now;
+
+	for (size_t i = 0; i < entry_count; i++) {
+		struct entry *e = &entries[i];
+
+		if (e->ready) {
+			e->total.ready_ns += now - e->ready_since_ns;
+			e->ready_since_ns = now;
+		}
+	}
+}
+
+void sys_trace_thread_switched_out_user(void)
+{
+	struct k_thread *thread = k_current_get();
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	uint64_t now = cpu_ns();
+	struct entry *e = entry_get(thread);
+
+	flush(now);
+	running = NULL;
+
+	/* Still in the run queue: it was preempted, not blocked */
+	if (e && (thread->base.thread_state & _THREAD_QUEUED)) {
+		e->ready = true;
+		e->ready_since_ns = now;
+	}
+
+	k_spin_unlock(&lock, key);
+}
+
+void sys_trace_thread_switched_in_user(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	uint64_t now = cpu_ns();
+	struct entry *e = entry_get(k_current_get());
+
+	flush(now);
+	running = e;
+
+	if (e) {
+		e->total.switches++;
+		e->ready = false;
+	}
+
+	k_spin_unlock(&lock, key);
+}
+
+void sys_trace_isr_enter_user(int nested_interrupts)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	ARG_UNUSED(nested_interrupts);
+
+	if (isr_depth++ == 0) {
+		flush(cpu_ns());
+		interrupted = running;
+		running = &entries[ISR_ENTRY];
+		running->total.switches++;
+	}
+
+	k_spin_unlock(&lock, key);
+}
+
+void sys_trace_isr_exit_user(int nested_interrupts)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	ARG_UNUSED(nested_interrupts);
+
+	if (isr_depth && --isr_depth == 0) {
+		flush(cpu_ns());
+		running = interrupted;
+	}
+
+	k_spin_unlock(&lock, key);
+}
+
+static void sample_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(sample_work, sample_work_handler);
+
+static void sample_work_handler(struct k_work *work)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	flush(cpu_ns());
+
+	sample_ms[sample_count] = k_uptime_get();
+	for (size_t i = 0; i < entry_count; i++) {
+		samples[sample_count][i] = entries[i].total;
+	}
+	sample_count++;
+
+	k_spin_unlock(&lock, key);
+
+	if (sample_count < ARRAY_SIZE(samples)) {
+		k_work_schedule(&sample_work, K_MSEC(CONFIG_THREAD_STATS_PERIOD_MS));
+	}
+}
+
+static const char *entry_name(const struct entry *e, char *buf, size_t len)
+{
+	if (e->name[0]) {
+		return e->name;
+	}
+
+	snprintk(buf, len, "%p", e->thread);
+
+	return buf;
+}
+
+/* One per-period series, `field` of struct counters, in us or count */
+#define PRINT_SERIES(i, field, div)                                                  \
+	do {                                                                         \
+		uint64_t prev = 0;                                                   \
+                                                                                     \
+		for (size_t s = 0; s < sample_count; s++) {                          \
+			printk("%s%llu", s ? ", " : "",                              \
+			       (uint64_t)(samples[s][i].field - prev) / (div));      \
+			prev = samples[s][i].field;                                  \
+		}                                                                    \
+	} while (0)
+
+static void thread_stats_print(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	uint64_t total_ns = 0;
+	char buf[2 + 2 * sizeof(void *) + 1];
+
+	flush(cpu_ns());
+
+	for (size_t i = 0; i < entry_count; i++) {
+		total_ns += entries[i].total.cpu_ns;
+	}
+
+	printk("[THREAD STATS] thread: cpu_ms (share) switches ready_ms\n");
+
+	for (size_t i = 0; i < entry_count; i++) {
+		const struct entry *e = &entries[i];
+
+		printk("[THREAD STATS] %s: %llu (%llu%%) %u %llu\n", entry_name(e, buf, sizeof(buf)),
+		       e->total.cpu_ns / NSEC_PER_MSEC,
+		       total_ns ? e->total.cpu_ns * 100U / total_ns : 0U, e->total.switches,
+		       e->total.ready_ns / NSEC_PER_MSEC);
+	}
+
+	if (entry_count == ARRAY_SIZE(entries)) {
+		printk("[THREAD STATS] more than %u threads, the others were not accounted\n",
+		       CONFIG_THREAD_STATS_MAX_THREADS);
+	}
+
+	printk("METRICS {\"thread_stats\": {\"period_ms\": %u, \"t_ms\": [",
+	       CONFIG_THREAD_STATS_PERIOD_MS);
+
+	for (size_t s = 0; s < sample_count; s++) {
+		printk("%s%lld", s ? ", " : "", sample_ms[s]);
+	}
+
+	printk("], \"threads\": [");
+
+	for (size_t i = 0; i < entry_count; i++) {
+		const struct entry *e = &entries[i];
+
+		printk("%s{\"name\": \"%s\", \"cpu_us\": %llu, \"switches\": %u, "
+		       "\"ready_us\": %llu, \"cpu_us_series\": [",
+		       i ? ", " : "", entry_name(e, buf, sizeof(buf)),
+		       e->total.cpu_ns / NSEC_PER_USEC, e->total.switches,
+		       e->total.ready_ns / NSEC_PER_USEC);
+		PRINT_SERIES(i, cpu_ns, NSEC_PER_USEC);
+		printk("], \"switches_series\": [");
+		PRINT_SERIES(i, switches, 1U);
+		printk("], \"ready_us_series\": [");
+		PRINT_SERIES(i, ready_ns, NSEC_PER_USEC);
+		printk("]}");
+	}
+
+	printk("]}}\n");
+
+	k_spin_unlock(&lock, key);
+}
+
+static int thread_stats_init(void)
+{
+	k_work_schedule(&sample_work, K_MSEC(CONFIG_THREAD_STATS_PERIOD_MS));
+
+	return 0;
+}
+
+SYS_INIT(thread_stats_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+NATIVE_TASK(thread_stats_print, ON_EXIT, 10);
@@ -22,9 +22,9 @@ pushd ${this_dir}/firmware/hci_sim
 west build -b nrf52_bsim
 popd
 
-# Build scanner image
+# Build scanner image, with the report counters printed on exit
 pushd ${this_dir}/firmware/observer
-west build -b nrf52_bsim
+west build -b nrf52_bsim -- -DEXTRA_CONF_FILE=overlay-bench.conf
 popd
 
 # Cleanup all existing sims
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 Nordic Semiconductor ASA
+# SPDX-License-Identifier: Apache-2.0
+
+"""Dense-advertiser scan throughput benchmark.
+
+Runs one simulation per advertiser count: the observer (built with
+overlay-bench.conf) plus N advertisers with random intervals and a mix of
+legacy and extended payloads. The simulations run unthrottled (no handbrake)
+for a fixed simulated time. One JSON object per count is written to the output
+file (JSON lines), with the observer's METRICS and the wall-clock time the
+simulation took.
+
+Example:
+    ./scan_bench.py --counts 10,50,100,200 --sim-length 10 -o scan_bench.jsonl
+"""
+
+import argparse
+import json
+import os
+import random
+import subprocess
+import sys
+import time
+
+THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+FW_DIR = os.path.join(THIS_DIR, 'firmware')
+
+OBSERVER_BUILD = 'build-bench'
+ADVERTISER_BUILD = 'build'
+LEGACY_AD_LEN = 31
+EXT_AD_LEN_MAX = 1650
+
+
+def build(app, build_dir, extra_args=()):
+    subprocess.run(['west', 'build', '-b', 'nrf52_bsim', '-d', build_dir,
+                    '--', *extra_args],
+                   cwd=os.path.join(FW_DIR, app), check=True)
+    return os.path.join(FW_DIR, app, build_dir, 'zephyr', 'zephyr.exe')
+
+
+def parse_metrics(output):
+    metrics = {}
+    for line in output.splitlines():
+        _, sep, payload = line.partition('METRICS ')
+        if sep:
+            metrics.update(json.loads(payload))
+    return metrics
+
+
+def advertiser_args(rng, args):
+    if rng.random() < args.ext_ratio:
+        length = rng.randint(args.ext_len_min, args.ext_len_max)
+        return ['-adv_ext', '-adv_len=%d' % length]
+    return ['-adv_len=%d' % LEGACY_AD_LEN]
+
+
+def run_one(count, observer, advertiser, args, rng):
+    sim_id = 'scan-bench-%d' % count
+    sim_length_us = int(args.sim_length * 1e6)
+    bsim_bin = os.path.join(os.environ['BSIM_OUT_PATH'], 'bin')
+
+    procs = [subprocess.Popen(['./bs_2G4_phy_v1', '-s=' + sim_id,
+                               '-D=%d' % (count + 1),
+                               '-sim_length=%d' % sim_length_us],
+                              cwd=bsim_bin, stdout=subprocess.DEVNULL)]
+
+    for d in range(1, count + 1):
+        cmd = [advertiser, '-s=' + sim_id, '-d=%d' % d, '-rs=%d' % (args.seed + d),
+               '-adv_interval_min=%d' % args.interval_min,
+               '-adv_interval_max=%d' % args.interval_max]
+        cmd += advertiser_args(rng, args)
+        procs.append(subprocess.Popen(cmd, stdout=subprocess.DEVNULL))
+
+    start = time.monotonic()
+    observer_proc = subprocess.run([observer, '-s=' + sim_id, '-d=0',
+                                    '-rs=%d' % args.seed],
+                                   stdout=subprocess.PIPE, text=True)
+    wall_s = time.monotonic() - start
+
+    status = [p.wait() for p in procs]
+
+    return {
+        'advertisers': count,
+        'sim_length_s': args.sim_length,
+        'wall_s': wall_s,
+        'exit_status': [observer_proc.returncode] + status,
+        **parse_metrics(observer_proc.stdout),
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Dense-advertiser scan benchmark')
+    parser.add_argument('--counts', default='10,50,100',
+                        help='comma separated advertiser counts (default: %(default)s)')
+    parser.add_argument('--sim-length', type=float, default=10,
+                        help='simulated seconds per run (default: %(default)s)')
+    parser.add_argument('--ext-ratio', type=float, default=0.5,
+                        help='fraction of extended advertisers (default: %(default)s)')
+    parser.add_argument('--ext-len-min', type=int, default=32)
+    parser.add_argument('--ext-len-max', type=int, default=EXT_AD_LEN_MAX)
+    parser.add_argument('--interval-min', type=int, default=20,
+                        help='advertising interval lower bound in ms')
+    parser.add_argument('--interval-max', type=int, default=200,
+                        help='advertising interval upper bound in ms')
+    parser.add_argument('--seed', type=int, default=70)
+    parser.add_argument('--observer-conf', default='',
+                        help='extra observer conf files, separated by ;')
+    parser.add_argument('--no-build', action='store_true')
+    parser.add_argument('-o', '--output', default='scan_bench.jsonl')
+    args = parser.parse_args()
+
+    args.ext_len_max = min(args.ext_len_max, EXT_AD_LEN_MAX)
+
+    conf = ';'.join(filter(None, ['overlay-bench.conf', args.observer_conf]))
+    if args.no_build:
+        observer = os.path.join(FW_DIR, 'observer', OBSERVER_BUILD, 'zephyr', 'zephyr.exe')
+        advertiser = os.path.join(FW_DIR, 'advertiser', ADVERTISER_BUILD, 'zephyr', 'zephyr.exe')
+    else:
+        observer = build('observer', OBSERVER_BUILD, ['-DEXTRA_CONF_FILE=' + conf])
+        advertiser = build('advertiser', ADVERTISER_BUILD)
+
+    rng = random.Random(args.seed)
+
+    with open(args.output, 'w') as out:
+        for count in (int(c) for c in args.counts.split(',')):
+            print('Running with %d advertisers' % count, file=sys.stderr)
+            result = run_one(count, observer, advertiser, args, rng)
+            out.write(json.dumps(result) + '\n')
+            out.flush()
+            print(json.dumps(result), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,245 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 Nordic Semiconductor ASA
+# SPDX-License-Identifier: Apache-2.0
+
+"""Radio on-time and energy estimate per device, from the bsim 2G4 PHY dumps.
+
+Reads the same `d_2G4_NN.Tx.csv` / `d_2G4_NN.Rx.csv` files as rf_stats.py and,
+for each device, adds up:
+
+- TX time: every transmitted packet, aborted ones up to the abort
+- RX time, split into receiving (from the start of the RX window to the end
+  of a packet that was synchronised to) and idle listening (RX windows, scan
+  windows included, in which nothing was received)
+- radio ramp-up: one per TX or RX operation
+- CPU-active time: simulated time doesn't pass while the firmware runs, so it
+  can't be measured in bsim. It is estimated as a fixed cost per radio event
+  (a burst of radio operations less than 1 ms apart: an advertising event, a
+  connection event, a scan window)
+- sleep: the rest of the simulated time
+
+and converts them to charge and energy with a current profile. The default
+one is typical figures for an nRF52832 at 3 V with the DC/DC regulator on, 0 dBm
+TX and 1 Mbps; override it with `--profile profile.json` and/or `--set
+key=value` (see PROFILE below). Sleep current is counted for the whole span of
+the simulation, so compare runs of the same length.
+
+Usage:
+    energy.py my-sim-id                   # reads $BSIM_OUT_PATH/results/my-sim-id
+    energy.py --set tx_ma=7.5 --set voltage=1.8 path/to/results/dir
+    energy.py --sim-length 60 --format csv -o energy.csv my-sim-id
+"""
+
+import argparse
+import csv
+import heapq
+import json
+import sys
+
+from rf_stats import (CONN_EVENT_GAP_US, END_KEYS, RX_STATUS_HEADER_ERROR, RX_STATUS_OK,
+                      START_KEYS, field, find_dumps, to_int, tx_records)
+
+PROFILE = {
+    'voltage': 3.0,
+    # Radio, mA
+    'tx_ma': 5.3,
+    'rx_ma': 5.4,
+    'ramp_ma': 4.0,
+    # TXRU/RXRU
+    'ramp_us': 140,
+    # CPU running from flash at 64 MHz, mA
+    'cpu_ma': 3.7,
+    'cpu_us_per_event': 150,
+    # System ON, RTC running, RAM retained, uA
+    'sleep_ua': 1.9,
+}
+
+# Adds the 3 byte CRC to packet_size, which is header + payload
+CRC_LEN = 3
+
+
+def rx_records(path, device):
+    """Yield (start, end, device, received) from an Rx dump.
+
+    `received` is True if the radio synchronised to a packet, it then listened
+    up to the end of that packet. Otherwise it listened for the whole window.
+    """
+    with open(path, newline='') as f:
+        for row in csv.DictReader(f):
+            start = to_int(field(row, START_KEYS))
+            status = to_int(field(row, ('status', 'rx_status')))
+            received = RX_STATUS_OK <= status <= RX_STATUS_HEADER_ERROR
+
+            end = to_int(field(row, END_KEYS), None)
+            if end is None and received:
+                bps = to_int(row.get('bps'), 1000000) or 1000000
+                size = to_int(row.get('packet_size'))
+                end = (to_int(row.get('rx_time_stamp'), start)
+                       + (size + CRC_LEN) * 8 * 1000000 // bps)
+            elif end is None:
+                end = start + to_int(row.get('scan_duration'))
+
+            abort = to_int(row.get('abort_time'), end)
+            if start < abort < end:
+                end = abort
+
+            yield start, max(end, start), device, received
+
+
+class Device:
+    def __init__(self, num):
+        self.num = num
+        self.tx_us = 0
+        self.tx_ops = 0
+        self.rx_us = 0
+        self.rx_idle_us = 0
+        self.rx_ops = 0
+        self.events = 0
+        self.event_end = None
+        self.last = 0
+
+    def activity(self, start, end):
+        if self.event_end is None or start - self.event_end > CONN_EVENT_GAP_US:
+            self.events += 1
+        self.event_end = max(end, self.event_end or 0)
+        self.last = max(self.last, end)
+
+    def report(self, span, profile):
+        ramp_us = (self.tx_ops + self.rx_ops) * profile['ramp_us']
+        cpu_us = self.events * profile['cpu_us_per_event']
+        radio_us = self.tx_us + self.rx_us + self.rx_idle_us + ramp_us
+        # The CPU mostly sleeps while the radio is on
+        sleep_us = max(span - radio_us - cpu_us, 0)
+
+        # mA * us = nC
+        charge_nc = {
+            'tx': self.tx_us * profile['tx_ma'],
+            'rx': self.rx_us * profile['rx_ma'],
+            'rx_idle': self.rx_idle_us * profile['rx_ma'],
+            'ramp': ramp_us * profile['ramp_ma'],
+            'cpu': cpu_us * profile['cpu_ma'],
+            'sleep': sleep_us * profile['sleep_ua'] / 1000,
+        }
+        total_nc = sum(charge_nc.values())
+
+        return {
+            'device': self.num,
+            'span_us': span,
+            'tx_us': self.tx_us,
+            'rx_us': self.rx_us,
+            'rx_idle_us': self.rx_idle_us,
+            'ramp_us': ramp_us,
+            'radio_on_ratio': radio_us / span if span else 0,
+            'radio_events': self.events,
+            'cpu_us_estimated': cpu_us,
+            'sleep_us': sleep_us,
+            'charge_uc': {k: v / 1000 for k, v in charge_nc.items()},
+            'charge_total_uc': total_nc / 1000,
+            'avg_current_ua': total_nc * 1000 / span if span else 0,
+            'energy_uj': total_nc * profile['voltage'] / 1000,
+        }
+
+
+def analyze(tx_paths, rx_paths, profile, span=None):
+    devices = {}
+
+    def device(num):
+        if num not in devices:
+            devices[num] = Device(num)
+        return devices[num]
+
+    for dev, path in tx_paths.items():
+        device(dev)
+    for dev, path in rx_paths.items():
+        device(dev)
+
+    # Each dump is sorted by start time, a device's TX and RX operations
+    # merged give its radio events in order.
+    for dev, d in devices.items():
+        streams = []
+        if dev in tx_paths:
+            streams.append((s, e, True, True) for s, e, _, _, _ in tx_records(tx_paths[dev], dev))
+        if dev in rx_paths:
+            streams.append((s, e, False, r) for s, e, _, r in rx_records(rx_paths[dev], dev))
+
+        for start, end, is_tx, received in heapq.merge(*streams):
+            d.activity(start, end)
+            if is_tx:
+                d.tx_ops += 1
+                d.tx_us += end - start
+            else:
+                d.rx_ops += 1
+                if received:
+                    d.rx_us += end - start
+                else:
+                    d.rx_idle_us += end - start
+
+    if span is None:
+        # Simulated time starts at 0 for all devices
+        span = max((d.last for d in devices.values()), default=0)
+
+    return {
+        'profile': profile,
+        'devices': [d.report(span, profile) for _, d in sorted(devices.items())],
+    }
+
+
+def write_csv(stats, out):
+    """Long format: one (scope, id, metric, value) row per metric"""
+    w = csv.writer(out)
+    w.writerow(['scope', 'id', 'metric', 'value'])
+
+    for d in stats['devices']:
+        for k, v in d.items():
+            if k == 'device':
+                continue
+            if k == 'charge_uc':
+                for part, charge in v.items():
+                    w.writerow(['device', d['device'], 'charge_%s_uc' % part, charge])
+                continue
+            w.writerow(['device', d['device'], k, v])
+
+
+def main():
+    parser = argparse.ArgumentParser(description='bsim radio on-time and energy estimate')
+    parser.add_argument('inputs', nargs='+',
+                        help='sim id, results directory or dump files')
+    parser.add_argument('--profile', help='JSON file with current profile values')
+    parser.add_argument('--set', action='append', default=[], metavar='KEY=VALUE',
+                        help='override one profile value, can be repeated')
+    parser.add_argument('--sim-length', type=float,
+                        help='simulated seconds (default: up to the last radio activity)')
+    parser.add_argument('--format', choices=('json', 'csv'), default='json')
+    parser.add_argument('-o', '--output', help='output file (default: stdout)')
+    args = parser.parse_args()
+
+    profile = dict(PROFILE)
+    if args.profile:
+        with open(args.profile) as f:
+            profile.update(json.load(f))
+    for s in args.set:
+        key, _, value = s.partition('=')
+        if key not in PROFILE:
+            sys.exit('Unknown profile key %s (known: %s)' % (key, ', '.join(PROFILE)))
+        profile[key] = float(value)
+
+    tx, rx = find_dumps(args.inputs)
+    if not tx and not rx:
+        sys.exit('No d_2G4_*.csv dumps found (was the PHY started with -D?)')
+
+    span = int(args.sim_length * 1e6) if args.sim_length else None
+    stats = analyze(tx, rx, profile, span)
+
+    out = open(args.output, 'w', newline='') if args.output else sys.stdout
+    if args.format == 'json':
+        json.dump(stats, out, indent=2)
+        out.write('\n')
+    else:
+        write_csv(stats, out)
+
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == '__main__':
+    main()
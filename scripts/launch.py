@@ -0,0 +1,322 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 Nordic Semiconductor ASA
+# SPDX-License-Identifier: Apache-2.0
+
+"""Declarative simulation launcher.
+
+A scenario file (JSON) lists the devices of a simulation, the images they run,
+their arguments and UART pipe transports, the external host programs talking
+to them and the handbrake ratio. The launcher:
+
+- rebuilds an image only if a file of its app (or one of the `watch`
+  directories) is newer than the image, or its conf files changed
+- starts the PHY, all devices and the handbrake at once
+- starts each host program as soon as its controller has opened the pipe (a
+  non-blocking open of the FIFO succeeds only once there is a reader), instead
+  of after a fixed sleep
+- stops everything when the simulation ends, when all hosts exit or on
+  Ctrl-C, and collects exit status and METRICS lines into results.json
+
+Scenario format (paths are relative to the repository root):
+
+    {
+      "sim_id": "python-id",
+      "handbrake": 10,                      # real-time factor, 0/absent: none
+      "sim_length_s": 30,                   # optional
+      "phy_args": ["-dump_imm"],
+      "watch": ["python-demo/drivers"],     # sources shared by the images
+      "devices": [
+        {"name": "hci_sim", "app": "python-demo/firmware/hci_sim",
+         "conf": ["overlay-x.conf"],         # optional EXTRA_CONF_FILE
+         "count": 1,                         # optional, instances
+         "args": ["-rs={d}"],                # {d}: device number, {i}: instance
+         "fifos": {"0": {"rx": "/tmp/py/uart.h2c", "tx": "/tmp/py/uart.c2h"}},
+         "console": false}                   # true: output to the terminal
+      ],
+      "hosts": [
+        {"name": "ble-host", "cmd": ["python3", "ble-host.py"], "cwd": "python-demo",
+         "wait_for": ["/tmp/py/uart.h2c"]}
+      ]
+    }
+
+Usage:
+    launch.py scripts/scenarios/python-demo.json
+    launch.py --no-build --out-dir /tmp/runs scripts/scenarios/gatt-bug.json
+"""
+
+import argparse
+import errno
+import glob
+import json
+import os
+import signal
+import subprocess
+import time
+
+REPO_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+STAMP = '.launch-conf'
+# Not sources: skipped when looking for changes
+IGNORED_DIRS = ('build', '.git', '__pycache__')
+
+
+def newest_mtime(paths):
+    newest = 0
+    for top in paths:
+        if os.path.isfile(top):
+            newest = max(newest, os.path.getmtime(top))
+            continue
+        for root, dirs, files in os.walk(top):
+            dirs[:] = [d for d in dirs if not d.startswith(IGNORED_DIRS)]
+            for f in files:
+                newest = max(newest, os.path.getmtime(os.path.join(root, f)))
+    return newest
+
+
+class Image:
+    def __init__(self, app, conf):
+        self.app_dir = os.path.join(REPO_DIR, app)
+        self.conf = conf
+        suffix = '-'.join(os.path.splitext(c)[0].replace('overlay-', '') for c in conf)
+        self.build_dir = os.path.join(self.app_dir, 'build-' + suffix if conf else 'build')
+        self.exe = os.path.join(self.build_dir, 'zephyr', 'zephyr.exe')
+
+    def stale(self, watch):
+        stamp = os.path.join(self.build_dir, STAMP)
+        if not os.path.exists(self.exe) or not os.path.exists(stamp):
+            return True
+        with open(stamp) as f:
+            if f.read() != ';'.join(self.conf):
+                return True
+        return newest_mtime([self.app_dir] + watch) > os.path.getmtime(self.exe)
+
+    def build(self):
+        cmd = ['west', 'build', '-b', 'nrf52_bsim', '-d', self.build_dir]
+        if self.conf:
+            cmd += ['--', '-DEXTRA_CONF_FILE=' + ';'.join(self.conf)]
+        subprocess.run(cmd, cwd=self.app_dir, check=True)
+        with open(os.path.join(self.build_dir, STAMP), 'w') as f:
+            f.write(';'.join(self.conf))
+
+
+def fifo_ready(path):
+    """True once someone has the FIFO open for reading"""
+    try:
+        fd = os.open(path, os.O_WRONLY | os.O_NONBLOCK)
+    except OSError as e:
+        if e.errno in (errno.ENXIO, errno.ENOENT):
+            return False
+        raise
+    os.close(fd)
+    return True
+
+
+class Launcher:
+    def __init__(self, scenario, args):
+        self.scenario = scenario
+        self.args = args
+        self.sim_id = scenario['sim_id']
+        self.run_dir = os.path.join(args.out_dir, self.sim_id)
+        self.procs = {}
+        self.logs = []
+
+    def start(self, name, cmd, cwd=None, console=False):
+        out = None
+        if not console:
+            out = open(os.path.join(self.run_dir, name + '.log'), 'w')
+            self.logs.append(out)
+        # Own process group, so Ctrl-C only reaches us and we stop them in order
+        self.procs[name] = subprocess.Popen(cmd, cwd=cwd, stdout=out,
+                                            stderr=subprocess.STDOUT if out else None,
+                                            start_new_session=True)
+
+    def devices(self):
+        """(name, device number, instance, spec) for every device instance"""
+        d = 0
+        for spec in self.scenario['devices']:
+            count = spec.get('count', 1)
+            for i in range(count):
+                name = spec['name'] if count == 1 else '%s-%d' % (spec['name'], i)
+                yield name, d, i, spec
+                d += 1
+
+    def build(self):
+        watch = [os.path.join(REPO_DIR, w) for w in self.scenario.get('watch', [])]
+        images = {}
+        for spec in self.scenario['devices']:
+            image = Image(spec['app'], spec.get('conf', []))
+            images.setdefault(image.build_dir, image)
+            spec['image'] = images[image.build_dir]
+
+        for image in images.values():
+            if self.args.no_build:
+                continue
+            if image.stale(watch):
+                print('Building %s' % os.path.relpath(image.build_dir, REPO_DIR))
+                image.build()
+            else:
+                print('Up to date: %s' % os.path.relpath(image.build_dir, REPO_DIR))
+
+    def launch(self):
+        os.makedirs(self.run_dir, exist_ok=True)
+        devices = list(self.devices())
+        handbrake = self.scenario.get('handbrake', 0)
+        num_devices = len(devices) + (1 if handbrake else 0)
+
+        for _, _, _, spec in devices:
+            for fifo in spec.get('fifos', {}).values():
+                for path in fifo.values():
+                    os.makedirs(os.path.dirname(path), exist_ok=True)
+                    if not os.path.exists(path):
+                        os.mkfifo(path)
+
+        phy = ['./bs_2G4_phy_v1', '-s=' + self.sim_id, '-D=%d' % num_devices]
+        if self.scenario.get('sim_length_s'):
+            phy.append('-sim_length=%d' % int(self.scenario['sim_length_s'] * 1e6))
+        self.start('phy', phy + self.scenario.get('phy_args', []),
+                   cwd=os.path.join(os.environ['BSIM_OUT_PATH'], 'bin'))
+
+        for name, d, i, spec in devices:
+            cmd = [spec['image'].exe, '-s=' + self.sim_id, '-d=%d' % d]
+            cmd += [a.format(d=d, i=i, run_dir=self.run_dir) for a in spec.get('args', [])]
+            for n, fifo in spec.get('fifos', {}).items():
+                cmd += ['-fifo_%s_rx=%s' % (n, fifo['rx']), '-fifo_%s_tx=%s' % (n, fifo['tx'])]
+            self.start(name, cmd, console=spec.get('console', False))
+
+        if handbrake:
+            self.start('handbrake', ['./bs_device_handbrake', '-s=' + self.sim_id,
+                                     '-d=%d' % len(devices), '-r=%g' % handbrake],
+                       cwd=os.path.join(os.environ['BSIM_COMPONENTS_PATH'], 'device_handbrake'))
+
+        self.wait_attached(num_devices)
+        print('Simulation %s running with %d devices' % (self.sim_id, num_devices))
+
+    def wait_attached(self, num_devices):
+        """Devices create their FIFOs to the PHY (in /tmp/bs_<user>/<sim_id>)
+        when they connect to it, before their firmware boots.
+        """
+        deadline = time.monotonic() + self.args.ready_timeout
+
+        while time.monotonic() < deadline:
+            if all(glob.glob('/tmp/bs_*/%s/*.d%d.dtp' % (self.sim_id, d))
+                   for d in range(num_devices)):
+                return
+            self.check_alive()
+            time.sleep(0.01)
+
+        raise RuntimeError('devices did not attach to the PHY in time')
+
+    def check_alive(self):
+        for name, p in self.procs.items():
+            if p.poll() is not None and name != 'phy':
+                raise RuntimeError('%s exited early (status %d)' % (name, p.returncode))
+
+    def start_hosts(self):
+        pending = list(self.scenario.get('hosts', []))
+        deadline = time.monotonic() + self.args.ready_timeout
+
+        while pending:
+            for host in list(pending):
+                if all(fifo_ready(p) for p in host.get('wait_for', [])):
+                    cwd = os.path.join(REPO_DIR, host['cwd']) if 'cwd' in host else None
+                    self.start(host['name'], host['cmd'], cwd=cwd,
+                               console=host.get('console', True))
+                    pending.remove(host)
+
+            if time.monotonic() > deadline:
+                raise RuntimeError('pipes not ready for %s' % ', '.join(h['name'] for h in pending))
+            time.sleep(0.01)
+
+    def wait(self):
+        hosts = [h['name'] for h in self.scenario.get('hosts', [])]
+
+        while self.procs['phy'].poll() is None:
+            if hosts and all(self.procs[h].poll() is not None for h in hosts):
+                print('All hosts exited')
+                return
+            time.sleep(0.1)
+
+    def stop(self, names, timeout):
+        for name in names:
+            if self.procs[name].poll() is None:
+                self.procs[name].send_signal(signal.SIGTERM)
+
+        deadline = time.monotonic() + timeout
+        for p in self.procs.values():
+            try:
+                p.wait(timeout=max(deadline - time.monotonic(), 0.1))
+            except subprocess.TimeoutExpired:
+                pass
+
+    def teardown(self):
+        # Hosts and the PHY first: devices end cleanly (and print their
+        # METRICS) when the PHY goes away. Then whatever is left.
+        hosts = [h['name'] for h in self.scenario.get('hosts', []) if h['name'] in self.procs]
+        self.stop(hosts + ['phy'] if 'phy' in self.procs else hosts, 5)
+        self.stop(list(self.procs), 2)
+
+        for p in self.procs.values():
+            if p.poll() is None:
+                p.kill()
+                p.wait()
+
+        for f in self.logs:
+            f.close()
+
+    def collect(self):
+        results = {'sim_id': self.sim_id, 'run_dir': self.run_dir, 'processes': {}}
+
+        for name, p in self.procs.items():
+            entry = {'exit_status': p.returncode}
+            log = os.path.join(self.run_dir, name + '.log')
+            if os.path.exists(log):
+                with open(log, errors='replace') as f:
+                    for line in f:
+                        _, sep, payload = line.partition('METRICS ')
+                        if sep:
+                            try:
+                                entry.setdefault('metrics', {}).update(json.loads(payload))
+                            except json.JSONDecodeError:
+                                pass
+            results['processes'][name] = entry
+
+        with open(os.path.join(self.run_dir, 'results.json'), 'w') as f:
+            json.dump(results, f, indent=2)
+
+        for name, entry in results['processes'].items():
+            print('%-16s exit %s%s' % (name, entry['exit_status'],
+                                       ', metrics: ' + ', '.join(entry['metrics'])
+                                       if 'metrics' in entry else ''))
+        return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Run a simulation scenario')
+    parser.add_argument('scenario', help='scenario JSON file')
+    parser.add_argument('--no-build', action='store_true', help='never rebuild images')
+    parser.add_argument('--ready-timeout', type=float, default=30,
+                        help='seconds to wait for devices and pipes (default: %(default)s)')
+    parser.add_argument('--out-dir', default=os.path.join(REPO_DIR, 'launch-results'))
+    args = parser.parse_args()
+
+    with open(args.scenario) as f:
+        scenario = json.load(f)
+
+    launcher = Launcher(scenario, args)
+    launcher.build()
+
+    start = time.monotonic()
+    try:
+        launcher.launch()
+        launcher.start_hosts()
+        launcher.wait()
+    except KeyboardInterrupt:
+        print('Interrupted')
+    finally:
+        launcher.teardown()
+
+    print('Ran for %.1f s' % (time.monotonic() - start))
+    launcher.collect()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 Nordic Semiconductor ASA
+# SPDX-License-Identifier: Apache-2.0
+
+"""Pairing, encryption and resume latency benchmark.
+
+Runs the gatt-bug central built with overlay-bond.conf (CONFIG_CENTRAL_SECURITY,
+a reconnection every few seconds) against one peripheral, for every seed and
+every `-RealEncryption` value asked for. Each run starts from blank flash on
+both devices: the first connection pairs and bonds, the following ones (one
+every few seconds) resume encryption with the stored LTK.
+
+From the central's connection statistics, it reports for each RealEncryption
+value:
+
+- pairing: connected -> keys distributed, on the first connection
+- security: connected -> encrypted, on the first connection
+- resume: connected -> encrypted with the stored LTK, on reconnections
+
+in simulated time, and the wall-clock time and real-time factor of the runs,
+which is where real crypto costs show up.
+
+The runs are done by sweep.py's machinery (same output layout, one directory
+per RealEncryption value), the summary is printed and written to
+`<out-dir>/summary.json`.
+
+Usage:
+    pairing_bench.py --seeds 20
+    pairing_bench.py --seeds 50 --sim-length 60 --real-encryption 1
+"""
+
+import argparse
+import concurrent.futures
+import copy
+import json
+import os
+import statistics
+import sys
+
+from sweep import build, parse_seeds, run_one
+
+VARIANT = 'bond'
+CONFS = ['overlay-bond.conf']
+LATENCIES = ('pairing', 'security', 'resume', 'reconnect')
+
+
+def weighted_avg(runs, name):
+    """Average over all samples of all runs, from the per-run count/avg"""
+    count = 0
+    total = 0
+    for r in runs:
+        l = r['metrics'].get(name + '_us')
+        if l and l['count']:
+            count += l['count']
+            total += l['count'] * l['avg']
+    return (total / count if count else None), count
+
+
+def summarize(results, real_encryption):
+    summary = {}
+
+    for re in real_encryption:
+        runs = [r for r in results if r['real_encryption'] == re]
+        ok = [r for r in runs if r['ok']]
+        rtf = [r['metrics']['sim_rtf']['rtf'] for r in ok if 'sim_rtf' in r['metrics']]
+        entry = {
+            'runs': len(runs),
+            'failed_seeds': [r['seed'] for r in runs if not r['ok']],
+            'wall_s_median': statistics.median(r['wall_s'] for r in ok) if ok else None,
+            'central_rtf_median': statistics.median(rtf) if rtf else None,
+        }
+
+        for name in LATENCIES:
+            avg, count = weighted_avg(ok, name)
+            worst = [r['metrics'][name + '_us']['max'] for r in ok
+                     if r['metrics'].get(name + '_us', {}).get('count')]
+            entry[name] = {
+                'count': count,
+                'avg_us': round(avg) if avg is not None else None,
+                'max_us': max(worst) if worst else None,
+            }
+
+        summary['RealEncryption=%d' % re] = entry
+
+    print('%-18s %5s %8s %6s  %s' % ('', 'runs', 'wall s', 'rtf',
+                                    '  '.join('%-18s' % (n + ' avg/max us') for n in LATENCIES)))
+    for name, e in summary.items():
+        cols = []
+        for n in LATENCIES:
+            cols.append('%-18s' % ('%s/%s (%d)' % (e[n]['avg_us'], e[n]['max_us'], e[n]['count'])))
+        print('%-18s %5d %8s %6s  %s' % (name, e['runs'],
+                                         '%.1f' % e['wall_s_median'] if e['wall_s_median'] else '-',
+                                         '%.2f' % e['central_rtf_median']
+                                         if e['central_rtf_median'] else '-',
+                                         '  '.join(cols)))
+        if e['failed_seeds']:
+            print('    failed seeds: %s' % ' '.join(str(s) for s in e['failed_seeds']))
+
+    return summary
+
+
+def main():
+    parser = argparse.ArgumentParser(description='gatt-bug pairing/resume latency benchmark')
+    parser.add_argument('--seeds', default='20',
+                        help='N (1..N), A-B, or a comma separated list (default: %(default)s)')
+    parser.add_argument('--real-encryption', default='0,1',
+                        help='comma separated -RealEncryption values (default: %(default)s)')
+    parser.add_argument('--sim-length', type=float, default=30,
+                        help='simulated seconds per run (default: %(default)s)')
+    parser.add_argument('--timeout', type=float, default=600,
+                        help='wall-clock seconds before a run is killed (default: %(default)s)')
+    parser.add_argument('-j', '--jobs', type=int, default=os.cpu_count(),
+                        help='simulations running at once (default: %(default)s)')
+    parser.add_argument('--no-build', action='store_true')
+    parser.add_argument('--out-dir', default='pairing-results')
+    args = parser.parse_args()
+
+    real_encryption = [int(v) for v in args.real_encryption.split(',')]
+    seeds = parse_seeds(args.seeds)
+
+    if not args.no_build:
+        print('Building variant %s' % VARIANT, file=sys.stderr)
+        build(VARIANT, CONFS)
+
+    jobs = []
+    for re in real_encryption:
+        run_args = copy.copy(args)
+        run_args.device_args = ['-RealEncryption=%d' % re]
+        run_args.out_dir = os.path.join(args.out_dir, 'real-encryption-%d' % re)
+        os.makedirs(run_args.out_dir, exist_ok=True)
+        jobs += [(re, seed, run_args) for seed in seeds]
+
+    print('Running %d simulations, %d at a time' % (len(jobs), args.jobs), file=sys.stderr)
+
+    results = []
+    with open(os.path.join(args.out_dir, 'results.jsonl'), 'w') as out, \
+            concurrent.futures.ThreadPoolExecutor(max_workers=args.jobs) as pool:
+        futures = {pool.submit(run_one, i, VARIANT, 1, seed, run_args): re
+                   for i, (re, seed, run_args) in enumerate(jobs)}
+
+        for done, future in enumerate(concurrent.futures.as_completed(futures), 1):
+            r = future.result()
+            r['real_encryption'] = futures[future]
+            results.append(r)
+            out.write(json.dumps(r) + '\n')
+            out.flush()
+            print('[%d/%d] RealEncryption=%d %s: %s' %
+                  (done, len(jobs), r['real_encryption'], r['run'],
+                   'ok' if r['ok'] else 'FAILED'), file=sys.stderr)
+
+    summary = summarize(results, real_encryption)
+    with open(os.path.join(args.out_dir, 'summary.json'), 'w') as f:
+        json.dump(summary, f, indent=2)
+
+    sys.exit(0 if all(r['ok'] for r in results) else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,375 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 Nordic Semiconductor ASA
+# SPDX-License-Identifier: Apache-2.0
+
+"""RF trace analytics for the bsim 2G4 PHY dumps.
+
+Reads the `d_2G4_NN.Tx.csv` / `d_2G4_NN.Rx.csv` files that the PHY writes when
+started with `-D=<n>`, in a single pass, and computes per-device and
+per-connection metrics:
+
+- airtime (per device, split advertising / data)
+- advertising duty cycle and mean advertising event interval
+- per-connection goodput (new LL data payload bytes, per direction)
+- LL retransmissions (repeated SN from the same sender)
+- CRC failures (from the receivers' point of view)
+- connection event utilisation
+
+Usage:
+    rf_stats.py my-sim-id                   # reads $BSIM_OUT_PATH/results/my-sim-id
+    rf_stats.py path/to/results/dir
+    rf_stats.py d_2G4_00.Tx.csv d_2G4_01.Tx.csv ...
+    rf_stats.py --format csv -o stats.csv my-sim-id
+"""
+
+import argparse
+import csv
+import glob
+import heapq
+import json
+import os
+import re
+import statistics
+import sys
+
+ADV_ACCESS_ADDRESS = 0x8E89BED6
+
+# Two packets on the same access address separated by less than this belong to
+# the same connection (or advertising) event. T_IFS is 150us, the shortest
+# connection interval is 7.5ms.
+CONN_EVENT_GAP_US = 1000
+ADV_EVENT_GAP_US = 5000
+
+# p2G4 RX status codes
+RX_STATUS_OK = 1
+RX_STATUS_CRC_ERROR = 2
+RX_STATUS_HEADER_ERROR = 3
+
+# LL data PDU header (first byte)
+LLID_MASK = 0x03
+LLID_CONTROL = 0x03
+SN_BIT = 0x08
+
+DUMP_NAME_RE = re.compile(r'd_2G4_?(\d+)\.(Tx|Rx)\.csv$')
+
+# The dump column names changed between PHY API versions, accept both.
+START_KEYS = ('start_time', 'start_tx_time', 'start_packet_time')
+END_KEYS = ('end_time', 'end_tx_time', 'end_packet_time')
+
+
+def field(row, keys, default=None):
+    for k in keys:
+        if k in row and row[k] != '':
+            return row[k]
+    return default
+
+
+def to_int(value, default=0):
+    if value is None:
+        return default
+    try:
+        return int(value, 0)
+    except ValueError:
+        return int(float(value))
+
+
+def parse_packet(value):
+    if not value:
+        return b''
+    return bytes(int(b, 16) for b in value.split())
+
+
+def tx_records(path, device):
+    """Yield (start, end, device, access_address, packet) from a Tx dump"""
+    with open(path, newline='') as f:
+        for row in csv.DictReader(f):
+            start = to_int(field(row, START_KEYS))
+            end = to_int(field(row, END_KEYS))
+            abort = to_int(row.get('abort_time'), end)
+            if start < abort < end:
+                end = abort
+
+            yield (start, end, device,
+                   to_int(row.get('phy_address')),
+                   parse_packet(row.get('packet')))
+
+
+def find_dumps(inputs):
+    paths = []
+    for i in inputs:
+        if os.path.isfile(i):
+            paths.append(i)
+            continue
+
+        if not os.path.isdir(i):
+            i = os.path.join(os.environ.get('BSIM_OUT_PATH', ''), 'results', i)
+        paths += glob.glob(os.path.join(i, 'd_2G4*.csv'))
+
+    tx, rx = {}, {}
+    for p in sorted(paths):
+        m = DUMP_NAME_RE.search(os.path.basename(p))
+        if not m:
+            continue
+        (tx if m.group(2) == 'Tx' else rx)[int(m.group(1))] = p
+
+    return tx, rx
+
+
+class Device:
+    def __init__(self, num):
+        self.num = num
+        self.first = None
+        self.last = 0
+        self.tx_packets = 0
+        self.airtime_us = 0
+        self.adv_airtime_us = 0
+        self.adv_packets = 0
+        self.adv_events = 0
+        self.adv_last_end = None
+        self.adv_event_starts = []
+        self.rx_ok = 0
+        self.crc_errors = 0
+        self.header_errors = 0
+
+    def span_us(self):
+        if self.first is None:
+            return 0
+        return self.last - self.first
+
+    def report(self):
+        span = self.span_us()
+        intervals = [b - a for a, b in zip(self.adv_event_starts,
+                                           self.adv_event_starts[1:])]
+        return {
+            'device': self.num,
+            'span_us': span,
+            'tx_packets': self.tx_packets,
+            'airtime_us': self.airtime_us,
+            'airtime_ratio': self.airtime_us / span if span else 0,
+            'adv_packets': self.adv_packets,
+            'adv_events': self.adv_events,
+            'adv_airtime_us': self.adv_airtime_us,
+            'adv_duty_cycle': self.adv_airtime_us / span if span else 0,
+            'adv_interval_mean_us': statistics.mean(intervals) if intervals else 0,
+            'rx_ok': self.rx_ok,
+            'crc_errors': self.crc_errors,
+            'header_errors': self.header_errors,
+        }
+
+
+class Link:
+    """One direction of a connection: one sender on one access address"""
+
+    def __init__(self):
+        self.packets = 0
+        self.empty = 0
+        self.control = 0
+        self.retransmits = 0
+        self.data_retransmits = 0
+        self.goodput_bytes = 0
+        self.last_sn = None
+
+    def add(self, packet):
+        self.packets += 1
+        if len(packet) < 2:
+            return
+
+        hdr, length = packet[0], packet[1]
+        sn = bool(hdr & SN_BIT)
+        retransmit = sn == self.last_sn
+        self.last_sn = sn
+
+        if retransmit:
+            self.retransmits += 1
+            if length:
+                self.data_retransmits += 1
+            return
+
+        if not length:
+            self.empty += 1
+        elif hdr & LLID_MASK == LLID_CONTROL:
+            self.control += 1
+        else:
+            self.goodput_bytes += length
+
+
+class Connection:
+    def __init__(self, aa):
+        self.aa = aa
+        self.first = None
+        self.last = 0
+        self.airtime_us = 0
+        self.links = {}
+        self.event_start = None
+        self.event_end = None
+        self.event_packets = 0
+        self.event_has_data = False
+        self.event_starts = []
+        self.event_durations = []
+        self.event_packet_counts = []
+        self.data_events = 0
+
+    def close_event(self):
+        if self.event_start is None:
+            return
+        self.event_starts.append(self.event_start)
+        self.event_durations.append(self.event_end - self.event_start)
+        self.event_packet_counts.append(self.event_packets)
+        self.data_events += self.event_has_data
+
+    def add(self, start, end, device, packet):
+        if self.first is None:
+            self.first = start
+        self.last = end
+        self.airtime_us += end - start
+
+        if self.event_start is None or start - self.event_end > CONN_EVENT_GAP_US:
+            self.close_event()
+            self.event_start = start
+            self.event_packets = 0
+            self.event_has_data = False
+        self.event_end = end
+        self.event_packets += 1
+        if len(packet) >= 2 and packet[1]:
+            self.event_has_data = True
+
+        self.links.setdefault(device, Link()).add(packet)
+
+    def report(self):
+        self.close_event()
+        self.event_start = None
+
+        span = self.last - self.first
+        intervals = [b - a for a, b in zip(self.event_starts, self.event_starts[1:])]
+        interval = statistics.median(intervals) if intervals else 0
+        events = len(self.event_starts)
+        busy = statistics.mean(self.event_durations) if events else 0
+
+        links = {}
+        for dev, link in sorted(self.links.items()):
+            links[dev] = {
+                'packets': link.packets,
+                'empty': link.empty,
+                'control': link.control,
+                'retransmits': link.retransmits,
+                'data_retransmits': link.data_retransmits,
+                'goodput_bytes': link.goodput_bytes,
+                'goodput_bps': link.goodput_bytes * 8e6 / span if span else 0,
+            }
+
+        return {
+            'access_address': '0x%08X' % self.aa,
+            'devices': sorted(self.links),
+            'span_us': span,
+            'airtime_us': self.airtime_us,
+            'events': events,
+            'data_events': self.data_events,
+            'conn_interval_us': interval,
+            'packets_per_event_mean': (statistics.mean(self.event_packet_counts)
+                                       if events else 0),
+            'event_duration_mean_us': busy,
+            'event_utilisation': busy / interval if interval else 0,
+            'data_event_ratio': self.data_events / events if events else 0,
+            'links': links,
+        }
+
+
+def analyze(tx_paths, rx_paths):
+    devices = {}
+    conns = {}
+
+    def device(num):
+        if num not in devices:
+            devices[num] = Device(num)
+        return devices[num]
+
+    # The per-device dumps are each sorted by time, merging them gives us one
+    # time-ordered stream of everything that was on air.
+    streams = [tx_records(p, dev) for dev, p in tx_paths.items()]
+    for start, end, dev, aa, packet in heapq.merge(*streams):
+        d = device(dev)
+        if d.first is None:
+            d.first = start
+        d.last = end
+        d.tx_packets += 1
+        d.airtime_us += end - start
+
+        if aa == ADV_ACCESS_ADDRESS:
+            d.adv_packets += 1
+            d.adv_airtime_us += end - start
+            if d.adv_last_end is None or start - d.adv_last_end > ADV_EVENT_GAP_US:
+                d.adv_events += 1
+                d.adv_event_starts.append(start)
+            d.adv_last_end = end
+            continue
+
+        if aa not in conns:
+            conns[aa] = Connection(aa)
+        conns[aa].add(start, end, dev, packet)
+
+    for dev, path in rx_paths.items():
+        d = device(dev)
+        with open(path, newline='') as f:
+            for row in csv.DictReader(f):
+                status = to_int(field(row, ('status', 'rx_status')))
+                if status == RX_STATUS_OK:
+                    d.rx_ok += 1
+                elif status == RX_STATUS_CRC_ERROR:
+                    d.crc_errors += 1
+                elif status == RX_STATUS_HEADER_ERROR:
+                    d.header_errors += 1
+
+    return {
+        'devices': [d.report() for _, d in sorted(devices.items())],
+        'connections': [c.report() for _, c in sorted(conns.items())],
+    }
+
+
+def write_csv(stats, out):
+    """Long format: one (scope, id, metric, value) row per metric"""
+    w = csv.writer(out)
+    w.writerow(['scope', 'id', 'metric', 'value'])
+
+    for d in stats['devices']:
+        for k, v in d.items():
+            if k != 'device':
+                w.writerow(['device', d['device'], k, v])
+
+    for c in stats['connections']:
+        aa = c['access_address']
+        for k, v in c.items():
+            if k in ('access_address', 'devices', 'links'):
+                continue
+            w.writerow(['connection', aa, k, v])
+        for dev, link in c['links'].items():
+            for k, v in link.items():
+                w.writerow(['link', '%s/%d' % (aa, dev), k, v])
+
+
+def main():
+    parser = argparse.ArgumentParser(description='bsim RF trace analytics')
+    parser.add_argument('inputs', nargs='+',
+                        help='sim id, results directory or dump files')
+    parser.add_argument('--format', choices=('json', 'csv'), default='json')
+    parser.add_argument('-o', '--output', help='output file (default: stdout)')
+    args = parser.parse_args()
+
+    tx, rx = find_dumps(args.inputs)
+    if not tx:
+        sys.exit('No d_2G4_*.Tx.csv dumps found (was the PHY started with -D?)')
+
+    stats = analyze(tx, rx)
+
+    out = open(args.output, 'w', newline='') if args.output else sys.stdout
+    if args.format == 'json':
+        json.dump(stats, out, indent=2)
+        out.write('\n')
+    else:
+        write_csv(stats, out)
+
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == '__main__':
+    main()
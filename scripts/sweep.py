@@ -0,0 +1,234 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 Nordic Semiconductor ASA
+# SPDX-License-Identifier: Apache-2.0
+
+"""Parallel seed/parameter sweep of the gatt-bug simulation.
+
+Every combination of build variant, peripheral count and seed is one
+independent simulation (central + N peripherals + PHY, no handbrake) with its
+own sim id, seeds and flash file. As many run concurrently as there are cores:
+the devices of a simulation run in lock-step, so one simulation keeps about
+one core busy.
+
+Each run's device output goes to `<out-dir>/<run>/`. One JSON line per run
+(exit status, timing, the central's METRICS, including `run_rx_count`) is
+written to `<out-dir>/results.jsonl`, and a summary per variant and peripheral
+count is printed at the end.
+
+A variant is a name and the overlay conf files to build with, e.g.
+`eatt=overlay-eatt.conf`. Each app only gets the overlays it has. The
+`default` variant is the plain build.
+
+Usage:
+    sweep.py --seeds 500
+    sweep.py --seeds 100 --peripherals 1,2,4 --variant default --variant eatt=overlay-eatt.conf
+    sweep.py --seeds 1000-1099 --sim-length 30 --jobs 8 --out-dir /tmp/sweep
+"""
+
+import argparse
+import concurrent.futures
+import itertools
+import json
+import os
+import statistics
+import subprocess
+import sys
+import time
+
+THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+GATT_BUG_DIR = os.path.join(os.path.dirname(THIS_DIR), 'gatt-bug')
+APPS = ('central', 'peripheral')
+
+
+def parse_seeds(spec):
+    """'500' -> 1..500, '1000-1099' -> 1000..1099, '3,7,12' -> those"""
+    if '-' in spec:
+        first, last = spec.split('-')
+        return list(range(int(first), int(last) + 1))
+    if ',' in spec:
+        return [int(s) for s in spec.split(',')]
+    return list(range(1, int(spec) + 1))
+
+
+def parse_variant(spec):
+    name, _, confs = spec.partition('=')
+    return name, [c for c in confs.split(';') if c]
+
+
+def parse_metrics(path):
+    metrics = {}
+    with open(path, errors='replace') as f:
+        for line in f:
+            _, sep, payload = line.partition('METRICS ')
+            if sep:
+                try:
+                    metrics.update(json.loads(payload))
+                except json.JSONDecodeError:
+                    pass
+    return metrics
+
+
+def build_dir(variant):
+    return 'build' if variant == 'default' else 'build-' + variant
+
+
+def build(variant, confs):
+    for app in APPS:
+        app_dir = os.path.join(GATT_BUG_DIR, app)
+        cmd = ['west', 'build', '-b', 'nrf52_bsim', '-d', build_dir(variant)]
+        app_confs = [c for c in confs if os.path.exists(os.path.join(app_dir, c))]
+        if app_confs:
+            cmd += ['--', '-DEXTRA_CONF_FILE=' + ';'.join(app_confs)]
+        subprocess.run(cmd, cwd=app_dir, check=True, stdout=subprocess.DEVNULL)
+
+
+def exe(app, variant):
+    return os.path.join(GATT_BUG_DIR, app, build_dir(variant), 'zephyr', 'zephyr.exe')
+
+
+def run_one(index, variant, peripherals, seed, args):
+    name = '%s-p%d-s%d' % (variant, peripherals, seed)
+    run_dir = os.path.join(args.out_dir, name)
+    sim_id = 'sweep-%d-%d' % (os.getpid(), index)
+    bsim_bin = os.path.join(os.environ['BSIM_OUT_PATH'], 'bin')
+    os.makedirs(run_dir, exist_ok=True)
+
+    # Every run starts from blank flash (no GATT cache, no bonds), with a file
+    # per device: the flash model's default ./flash.bin would be shared
+    def blank_flash(file):
+        path = os.path.join(run_dir, file)
+        if os.path.exists(path):
+            os.remove(path)
+        return path
+
+    flash = blank_flash('central.bin')
+
+    logs = []
+
+    def start(cmd, log, cwd=None):
+        f = open(os.path.join(run_dir, log), 'w')
+        logs.append(f)
+        return subprocess.Popen(cmd, cwd=cwd, stdout=f, stderr=subprocess.STDOUT)
+
+    start_s = time.monotonic()
+    procs = [start(['./bs_2G4_phy_v1', '-s=' + sim_id, '-D=%d' % (peripherals + 1),
+                    '-rs=%d' % seed, '-sim_length=%d' % int(args.sim_length * 1e6)],
+                   'phy.log', cwd=bsim_bin)]
+
+    for d in range(1, peripherals + 1):
+        procs.append(start([exe('peripheral', variant), '-s=' + sim_id, '-d=%d' % d,
+                            '-rs=%d' % (seed * 1000 + d),
+                            '-flash=' + blank_flash('peripheral-%d.bin' % d), *args.device_args],
+                           'peripheral-%d.log' % d))
+
+    procs.append(start([exe('central', variant), '-s=' + sim_id, '-d=0',
+                        '-rs=%d' % (seed * 1000), '-flash=' + flash, *args.device_args],
+                       'central.log'))
+
+    timed_out = False
+    status = []
+    for p in procs:
+        remaining = args.timeout - (time.monotonic() - start_s)
+        try:
+            status.append(p.wait(timeout=max(remaining, 0.1)))
+        except subprocess.TimeoutExpired:
+            timed_out = True
+            for q in procs:
+                q.kill()
+            status.append(p.wait())
+
+    for f in logs:
+        f.close()
+
+    metrics = parse_metrics(os.path.join(run_dir, 'central.log'))
+
+    return {
+        'run': name,
+        'variant': variant,
+        'peripherals': peripherals,
+        'seed': seed,
+        'sim_id': sim_id,
+        'ok': not timed_out and not any(status),
+        'timed_out': timed_out,
+        'exit_status': status,
+        'wall_s': round(time.monotonic() - start_s, 3),
+        'run_rx_count': metrics.get('run_rx_count'),
+        'metrics': metrics,
+        'dir': run_dir,
+    }
+
+
+def summarize(results):
+    groups = {}
+    for r in results:
+        groups.setdefault((r['variant'], r['peripherals']), []).append(r)
+
+    print('%-12s %5s %6s %6s  %s' % ('variant', 'perip', 'runs', 'failed',
+                                     'run_rx_count min/median/max'))
+    for (variant, peripherals), runs in sorted(groups.items()):
+        failed = [r for r in runs if not r['ok']]
+        rx = [r['run_rx_count'] for r in runs if r['run_rx_count'] is not None]
+        rx_str = '%d/%d/%d' % (min(rx), statistics.median(rx), max(rx)) if rx else '-'
+
+        print('%-12s %5d %6d %6d  %s' % (variant, peripherals, len(runs), len(failed), rx_str))
+        if failed:
+            print('    failed seeds: %s' % ' '.join(str(r['seed']) for r in failed))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Parallel gatt-bug seed/parameter sweep')
+    parser.add_argument('--seeds', default='100',
+                        help='N (1..N), A-B, or a comma separated list (default: %(default)s)')
+    parser.add_argument('--peripherals', default='1',
+                        help='comma separated peripheral counts (default: %(default)s)')
+    parser.add_argument('--variant', action='append',
+                        help='NAME[=overlay.conf;...], can be repeated (default: default)')
+    parser.add_argument('--sim-length', type=float, default=20,
+                        help='simulated seconds per run (default: %(default)s)')
+    parser.add_argument('--timeout', type=float, default=600,
+                        help='wall-clock seconds before a run is killed (default: %(default)s)')
+    parser.add_argument('--device-args', default='',
+                        help='extra arguments for every device, e.g. "-RealEncryption=1"')
+    parser.add_argument('-j', '--jobs', type=int, default=os.cpu_count(),
+                        help='simulations running at once (default: %(default)s)')
+    parser.add_argument('--no-build', action='store_true')
+    parser.add_argument('--out-dir', default='sweep-results')
+    args = parser.parse_args()
+
+    args.device_args = args.device_args.split()
+    variants = [parse_variant(v) for v in (args.variant or ['default'])]
+    peripherals = [int(p) for p in args.peripherals.split(',')]
+    seeds = parse_seeds(args.seeds)
+
+    if not args.no_build:
+        for name, confs in variants:
+            print('Building variant %s' % name, file=sys.stderr)
+            build(name, confs)
+
+    os.makedirs(args.out_dir, exist_ok=True)
+    jobs = list(itertools.product([v[0] for v in variants], peripherals, seeds))
+    print('Running %d simulations, %d at a time' % (len(jobs), args.jobs), file=sys.stderr)
+
+    results = []
+    start = time.monotonic()
+    with open(os.path.join(args.out_dir, 'results.jsonl'), 'w') as out, \
+            concurrent.futures.ThreadPoolExecutor(max_workers=args.jobs) as pool:
+        futures = [pool.submit(run_one, i, *job, args) for i, job in enumerate(jobs)]
+
+        for done, future in enumerate(concurrent.futures.as_completed(futures), 1):
+            r = future.result()
+            results.append(r)
+            out.write(json.dumps(r) + '\n')
+            out.flush()
+            print('[%d/%d] %s: %s, run_rx_count %s' %
+                  (done, len(jobs), r['run'], 'ok' if r['ok'] else 'FAILED',
+                   r['run_rx_count']), file=sys.stderr)
+
+    print('%d simulations in %.0f s' % (len(jobs), time.monotonic() - start), file=sys.stderr)
+    summarize(results)
+
+    sys.exit(0 if all(r['ok'] for r in results) else 1)
+
+
+if __name__ == '__main__':
+    main()
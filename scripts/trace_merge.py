@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 Nordic Semiconductor ASA
+# SPDX-License-Identifier: Apache-2.0
+
+"""Merge the sim_trace files of a simulation into one Perfetto timeline.
+
+Devices built with CONFIG_SIM_TRACE and started with `-trace=<file>` write
+their tracepoints to that file on exit (see python-demo/lib/sim_trace). All
+devices of a simulation share the same simulated clock, so their traces line
+up without any correction. This writes them out as one Chrome trace event
+JSON file, which https://ui.perfetto.dev (or chrome://tracing) opens:
+
+- one process per device, named after the file (or NAME= given on the command
+  line)
+- BEGIN/END tracepoints become spans, INSTANT ones markers
+- the two tracepoint arguments are shown as arg0/arg1
+
+Usage:
+    trace_merge.py hci_sim.trace.csv observer.trace.csv -o sim.json
+    trace_merge.py controller=/tmp/d0.csv host=/tmp/d1.csv -o sim.json
+    trace_merge.py launch-results/python-id/*.trace.csv -o sim.json
+"""
+
+import argparse
+import json
+import os
+import sys
+
+# BEGIN, END, INSTANT: same letters as the trace event format
+PHASES = ('b', 'e', 'i')
+
+
+def parse_source(spec):
+    """'name=path' or 'path', the name then being the file name up to the first dot"""
+    name, sep, path = spec.partition('=')
+    if not sep:
+        path = spec
+        name = os.path.basename(spec).split('.')[0]
+    return name, path
+
+
+def read_trace(path):
+    """Returns (dropped, [(sim_us, phase, name, arg0, arg1)])"""
+    dropped = 0
+    records = []
+
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if line.startswith('# dropped'):
+                dropped = int(line.split()[2])
+                continue
+            if not line or line.startswith('#'):
+                continue
+
+            sim_us, phase, name, arg0, arg1 = line.split(',')
+            records.append((int(sim_us), phase, name, int(arg0), int(arg1)))
+
+    return dropped, records
+
+
+def convert(pid, name, records, dropped):
+    events = [{'ph': 'M', 'name': 'process_name', 'pid': pid, 'tid': 0,
+               'args': {'name': name}}]
+
+    if dropped:
+        events.append({'ph': 'M', 'name': 'process_labels', 'pid': pid, 'tid': 0,
+                       'args': {'labels': '%d oldest records dropped' % dropped}})
+
+    for sim_us, phase, event, arg0, arg1 in records:
+        if phase not in PHASES:
+            continue
+
+        e = {'ph': phase, 'name': event, 'cat': 'sim', 'ts': sim_us, 'pid': pid,
+             'tid': 0, 'args': {'arg0': arg0, 'arg1': arg1}}
+
+        if phase == 'i':
+            e['s'] = 't'
+        else:
+            # Async spans: BEGIN and END are matched by name, within the device
+            e['id2'] = {'local': event}
+
+        events.append(e)
+
+    return events
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Merge sim_trace files into a Perfetto trace')
+    parser.add_argument('traces', nargs='+', metavar='[NAME=]FILE',
+                        help='trace files written with -trace=FILE')
+    parser.add_argument('-o', '--output', help='output file (default: stdout)')
+    args = parser.parse_args()
+
+    events = []
+    for pid, spec in enumerate(args.traces):
+        name, path = parse_source(spec)
+        dropped, records = read_trace(path)
+        events += convert(pid, name, records, dropped)
+
+        print('%s: %d records%s' % (name, len(records),
+                                    ', %d dropped' % dropped if dropped else ''),
+              file=sys.stderr)
+
+    out = open(args.output, 'w') if args.output else sys.stdout
+    json.dump({'traceEvents': events, 'displayTimeUnit': 'ms'}, out)
+    if args.output:
+        out.close()
+
+
+if __name__ == '__main__':
+    main()